@@ -0,0 +1,210 @@
+#include "annealing.hh"
+#include "profile.hh"
+
+#include <iomanip>
+#include <math.h>
+
+using namespace std;
+
+
+bool SimAnnealing::run() {
+  if (usesGap())
+    dbg() << "Upper bound: " << upperBound() << endl;
+  m_startTime = chrono::system_clock::now();
+  m_softBounds = m_params.softBounds;
+  if (m_softBounds)
+    startSoftBounds();
+  m_bestScore = m_scorer.score();
+  // Any schedule meeting the bounds beats a start violating them, which
+  // isn't kept as the best
+  if (m_softBounds && m_scorer.boundViolations() > 0)
+    m_bestScore = -numeric_limits<Score>::infinity();
+  else
+    handleNewBest();
+  if (!anneal(0, m_params.maxIterations, true))
+    return false;
+  if (m_softBounds) {
+    if (m_bestSchedule.empty()) {
+      err() << "No schedule met the participation and presentation bounds, "
+            << m_scorer.boundViolations() << " violations left" << endl;
+      return false;
+    }
+    restoreBest();
+    m_sched.restoreCountBounds();
+  }
+  outputStatus(info());
+  return true;
+}
+
+static const s32 PENALTY_SAMPLES = 1000;
+static const u64 PENALTY_PERIOD = 1000;
+
+void SimAnnealing::startSoftBounds() {
+  m_sched.relaxCountBounds();
+  // The largest change of the objective by a single move, estimated without
+  // the penalty. A move changes the violations by at least 1, so above it
+  // and 20 final temperatures no violating move is accepted at the end.
+  m_scorer.setPenaltyWeight(0);
+  m_scorer.recalcScore();
+  Score maxGain = 0;
+  for (Score delta : sampleScoreDeltas(PENALTY_SAMPLES))
+    maxGain = max(maxGain, abs(delta));
+  m_finalPenaltyWeight = max(m_params.initTemp, maxGain + 20 * m_params.finalTemp);
+  // The penalty starts at about the initial temperature, so violations are
+  // cheap at first
+  m_penaltyWeight = m_params.initTemp;
+  m_scorer.setPenaltyWeight(m_penaltyWeight);
+  m_scorer.recalcScore();
+}
+
+void SimAnnealing::adaptPenalty() {
+  double weight = m_penaltyWeight;
+  // penaltyGrowth is per 10000 iterations
+  if (m_scorer.boundViolations() > 0)
+    weight *= pow(m_params.penaltyGrowth, PENALTY_PERIOD / 10000.0);
+  // The last period runs at the final weight
+  double progress = min(1.0, double(m_iter + PENALTY_PERIOD) /
+                            max(u64(1), m_params.maxIterations));
+  weight = max(weight, m_params.initTemp *
+                       pow(m_finalPenaltyWeight / m_params.initTemp, progress));
+  if (weight == m_penaltyWeight)
+    return;
+  m_penaltyWeight = weight;
+  m_scorer.setPenaltyWeight(m_penaltyWeight);
+  m_scorer.recalcScore();
+}
+
+bool SimAnnealing::anneal(u64 firstIter, u64 lastIter, bool trackBest) {
+  double nextOutputSec = 0;
+  m_temperature = temperatureAt(firstIter);
+  for (m_iter = firstIter; m_iter < lastIter; ++m_iter) {
+    if (m_iter % 10000 == 0) {
+      m_temperature = temperatureAt(m_iter);
+      if (trackBest && elapsedSecs(m_startTime) >= nextOutputSec) {
+        if (!outputStatus(dbg()))
+          return false;
+        nextOutputSec += m_params.progressSeconds;
+      }
+      if (trackBest && reachedStopCondition()) {
+        restoreBest();
+        break;
+      }
+    }
+    if (m_softBounds && m_iter % PENALTY_PERIOD == 0)
+      adaptPenalty();
+    try {
+      oneIteration();
+      if (trackBest && m_scorer.score() > m_bestScore &&
+          (!m_softBounds || m_scorer.boundViolations() == 0)) {
+        if (!handleNewBest())
+          return false;
+        m_bestScore = m_scorer.score();
+      }
+    } catch(std::exception& e) {
+      err() << "Error in iter " << m_iter << ": " << e.what() << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static const s32 CALIBRATION_SAMPLES = 5000;
+static const double INIT_ACCEPTANCE = 0.8;
+static const double FINAL_ACCEPTANCE = 0.001;
+
+// Mean acceptance probability of the (negative) deltas at the temperature
+static double acceptanceRatio(const vector<Score>& deltas, double temperature) {
+  double sum = 0;
+  for (Score delta : deltas)
+    sum += exp(delta / temperature);
+  return sum / deltas.size();
+}
+
+// Bisection in log scale, the acceptance ratio grows with the temperature
+static double temperatureForAcceptance(const vector<Score>& deltas, double ratio) {
+  double low = 1e-12, high = 1e12;
+  for (s32 i = 0; i < 200; ++i) {
+    double mid = sqrt(low * high);
+    if (acceptanceRatio(deltas, mid) < ratio)
+      low = mid;
+    else
+      high = mid;
+  }
+  return sqrt(low * high);
+}
+
+bool calibrateTemperatures(Schedule& sched, Scorer& scorer, Params& params) {
+  SimAnnealing probe(sched, params, scorer);
+  vector<Score> worse;
+  for (Score delta : probe.sampleScoreDeltas(CALIBRATION_SAMPLES)) {
+    if (delta < 0)
+      worse.push_back(delta);
+  }
+  if (worse.empty()) {
+    err() << "No worsening moves sampled, keeping temperatures " << params.initTemp
+          << " to " << params.finalTemp << endl;
+    return false;
+  }
+  params.initTemp = temperatureForAcceptance(worse, INIT_ACCEPTANCE);
+  params.finalTemp = temperatureForAcceptance(worse, FINAL_ACCEPTANCE);
+  info() << "Calibrated temperatures from " << worse.size() << " worsening moves: "
+         << params.initTemp << " to " << params.finalTemp << endl;
+  return true;
+}
+
+double annealingTemperature(const Options& params, u64 iter) {
+  double tempRatio = params.finalTemp / params.initTemp;
+  return params.initTemp *
+    (exp(std::log(tempRatio) * (double(iter) / params.maxIterations)));
+}
+
+double SimAnnealing::temperatureAt(u64 iter) const {
+  return annealingTemperature(m_params, iter);
+}
+
+bool SimAnnealing::oneIteration() {
+  PROFILE_SCOPE(Iteration);
+  Score curScore = m_scorer.score();
+  Move move;
+  {
+    PROFILE_SCOPE(Propose);
+    if (!proposeMove(move))
+      return false;
+  }
+  if (!applyMove(move)) {
+    ASSERT(m_scorer.score() == curScore);
+    return false;
+  }
+  Score newScore = m_scorer.score();
+  if (newScore > curScore)
+    ++m_nImproving;
+  if (!shouldAcceptStep(curScore, newScore, m_temperature)) {
+    undoMove(move);
+    ASSERT(abs(m_scorer.score() - curScore) < (m_params.minNormScore / 1000));
+  }
+  return true;
+}
+
+bool SimAnnealing::outputStatus(ostream& s) {
+  s << "Iter " << double(m_iter) << "/" << double(m_params.maxIterations)
+    << " (" << setprecision(4)
+    << left << (100.0 * m_iter / m_params.maxIterations) << right << "%) temperature: "
+    << m_temperature << " score: " << m_scorer.score() << " (dbg:" << m_scorer.calcScore()
+    << ") best so far:" << m_bestScore;
+  outputGap(s) << " improving: " << m_nImproving;
+  if (m_softBounds)
+    s << " violations: " << m_scorer.boundViolations() << " penalty: " << m_penaltyWeight;
+  s << endl;
+  //outputSchedSummary(s << endl);
+  ASSERT(abs(m_scorer.score() - m_scorer.calcScore()) < (m_params.minNormScore / 1000));
+  reportProgress();
+  return saveBest();
+}
+
+bool SimAnnealing::shouldAcceptStep(Score curScore, Score newScore, double temperature) {
+  PROFILE_SCOPE(Accept);
+  if (newScore >= curScore)
+    return true;
+  double normDelta = double(newScore - curScore);
+  return randProb() < exp(normDelta / temperature);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "optimizer.hh"
+
+
+// Temperature of the exponential cooling schedule at the given iteration
+double annealingTemperature(const Options& params, u64 iter);
+
+// Sets the initial and final temperatures from a sample of moves from the
+// current schedule, so that about 80% and 0.1% of the worsening moves are
+// accepted. Returns false if no sampled move makes the score worse.
+bool calibrateTemperatures(Schedule& sched, Scorer& scorer, Params& params);
+
+// Simulated annealing over seat swaps and free person changes
+class SimAnnealing final : public Optimizer {
+public:
+  SimAnnealing(Schedule& sched, const Options& params, Scorer& scorer) :
+    Optimizer(sched, params, scorer), m_nImproving(0), m_softBounds(false), m_penaltyWeight(0),
+    m_finalPenaltyWeight(0) {}
+
+  virtual bool run() override;
+
+  // Runs iterations [firstIter, lastIter) of the temperature schedule. Only
+  // tracks the best schedule and reports status if trackBest is set.
+  bool anneal(u64 firstIter, u64 lastIter, bool trackBest);
+
+  double temperature() const { return m_temperature; }
+
+protected:
+  double m_temperature;
+  u64 m_nImproving; // Applied moves which raised the score
+  bool m_softBounds; // Count bounds relaxed, only schedules meeting them are kept
+  double m_penaltyWeight;
+  double m_finalPenaltyWeight; // Reached by the last iteration
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Temperature: " << m_temperature << std::endl;
+    s << "Improving moves: " << m_nImproving << std::endl;
+    if (m_softBounds)
+      s << "Penalty weight: " << m_penaltyWeight << std::endl;
+  }
+
+  double temperatureAt(u64 iter) const;
+  // Raises the penalty weight while the schedule violates the bounds, and at
+  // least along the geometric ramp to m_finalPenaltyWeight
+  void adaptPenalty();
+  // Relaxes the count bounds and sets the penalty ramp
+  void startSoftBounds();
+  bool oneIteration();
+  bool outputStatus(std::ostream& s);
+  bool shouldAcceptStep(Score curScore, Score newScore, double temperature);
+};
@@ -0,0 +1,503 @@
+// Anytime performance benchmark of the scheduling pipeline: runs the phases
+// (as findSchedule does) on a corpus of instances with several seeds each,
+// samples the best schedule over wall time and iterations, and summarizes
+// the runs per instance as median and interquartile curves, time to target
+// and area under the curve.
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "bound.hh"
+#include "feasibility.hh"
+#include "params.hh"
+#include "random.hh"
+#include "schedule.hh"
+#include "scorer.hh"
+#include "solver.hh"
+#include "utils.hh"
+
+using namespace std;
+namespace po = boost::program_options;
+
+
+// An instance of the corpus: a ratings file or generated ratings, and the
+// event's shape
+struct BenchInstance {
+  string name;
+  string file;              // Generated if empty
+  s32 nPeople, nAbstracts;  // Of generated ratings
+  s32 nRatings;             // Per person, of generated ratings
+  u64 seed;                 // Of generated ratings
+  Scenario scenario;
+};
+
+// The best schedule of a run at some point
+struct Sample {
+  s32 seed;
+  double seconds;  // Since the run started, sampling excluded
+  u64 iter;        // Over all phases
+  size_t phase;
+  Score score;     // Sum of ratings
+  Score minHappiness;
+};
+
+struct InstanceResult {
+  BenchInstance instance;
+  s32 nPeople, nAbstracts;
+  Score upperBound;
+  vector<vector<Sample>> runs; // By seed, in time order
+};
+
+struct Quartiles {
+  double q1, median, q3;
+};
+
+static const double INF = numeric_limits<double>::infinity();
+
+// Linear interpolation between the closest ranks
+static double quantile(vector<double> values, double q) {
+  if (values.empty())
+    return nan("");
+  sort(values.begin(), values.end());
+  double pos = q * (values.size() - 1);
+  size_t lower = floor(pos);
+  size_t upper = min(lower + 1, values.size() - 1);
+  if (values[upper] == INF)
+    return pos == lower ? values[lower] : INF;
+  return values[lower] + (pos - lower) * (values[upper] - values[lower]);
+}
+
+static Quartiles quartiles(const vector<double>& values) {
+  return Quartiles{quantile(values, 0.25), quantile(values, 0.5), quantile(values, 0.75)};
+}
+
+// "name=big,people=1000,abstracts=600,ratings=20,rooms=40" or
+// "name=example,file=data/example/rating_example.csv,rooms=9": the instance
+// settings, then any scenario setting over the defaults
+static bool parseInstance(const string& spec, const Scenario& defaults, BenchInstance& instance) {
+  instance = BenchInstance{"", "", 1000, 600, 20, 1, defaults};
+  vector<string> settings, scenarioSettings;
+  boost::split(settings, spec, boost::is_any_of(","));
+  for (string setting : settings) {
+    boost::trim(setting);
+    size_t eq = setting.find('=');
+    if (eq == string::npos) {
+      err() << "Instance setting should be key=value. Got: " << setting << endl;
+      return false;
+    }
+    string key = setting.substr(0, eq), value = setting.substr(eq + 1);
+    try {
+      if (key == "name")
+        instance.name = value;
+      else if (key == "file")
+        instance.file = value;
+      else if (key == "people")
+        instance.nPeople = stoi(value);
+      else if (key == "abstracts")
+        instance.nAbstracts = stoi(value);
+      else if (key == "ratings")
+        instance.nRatings = stoi(value);
+      else if (key == "seed")
+        instance.seed = stoull(value);
+      else
+        scenarioSettings.push_back(setting);
+    } catch (const std::logic_error& e) {
+      err() << "Bad value for instance setting " << key << ": " << value << endl;
+      return false;
+    }
+  }
+  if (instance.file.empty() &&
+      (instance.nAbstracts < 1 || instance.nPeople < instance.nAbstracts ||
+       instance.nRatings < 1 || instance.nRatings >= instance.nAbstracts)) {
+    err() << "Generated instance needs 1 <= abstracts <= people and 1 <= ratings < abstracts" << endl;
+    return false;
+  }
+  if (instance.name.empty())
+    instance.name = instance.file.empty() ? "generated" : boost::filesystem::path(instance.file).stem().string();
+  return scenarioSettings.empty() ||
+         parseScenario(boost::algorithm::join(scenarioSettings, ","), instance.scenario);
+}
+
+// Every person rates nRatings abstracts other than their own, drawn with a
+// Zipf-like popularity so that some abstracts are in demand and others
+// hardly rated, with scores uniform in [1, maxScore]. The same settings give
+// the same ratings.
+static vector<Rating> generateRatings(const BenchInstance& instance, const Params& params) {
+  Rng rng(instance.seed);
+  vector<double> cumWeights(instance.nAbstracts);
+  vector<ID> byPopularity(instance.nAbstracts);
+  iota(byPopularity.begin(), byPopularity.end(), 0);
+  for (s32 i = instance.nAbstracts - 1; i > 0; --i)
+    swap(byPopularity[i], byPopularity[boundedRand(rng, i + 1)]);
+  double total = 0;
+  for (s32 i = 0; i < instance.nAbstracts; ++i)
+    cumWeights[i] = (total += 1 / pow(i + 1, 0.8));
+
+  vector<Rating> ratings;
+  vector<bool> rated(instance.nAbstracts);
+  for (ID person = 0; person < instance.nPeople; ++person) {
+    fill(rated.begin(), rated.end(), false);
+    if (person < instance.nAbstracts)
+      rated[person] = true; // Their own
+    for (s32 n = 0; n < instance.nRatings;) {
+      double r = bitsToProb(rng.next()) * total;
+      ID abstract = byPopularity[upper_bound(cumWeights.begin(), cumWeights.end(), r) -
+                                 cumWeights.begin()];
+      if (rated[abstract])
+        continue;
+      rated[abstract] = true;
+      Score score = 1 + boundedRand(rng, max(1, s32(params.maxScore)));
+      ratings.push_back(Rating{person, abstract, score});
+      ++n;
+    }
+  }
+  return ratings;
+}
+
+static bool instanceParams(const BenchInstance& instance, const Params& base, Params& params) {
+  params = base;
+  params.nTimeslots = instance.scenario.nTimeslots;
+  params.nRooms = instance.scenario.nRooms;
+  params.roomSize = instance.scenario.roomSize;
+  params.participationRange = instance.scenario.participationRange;
+  params.maxPresentations = instance.scenario.maxPresentations;
+  if (!instance.file.empty()) {
+    if (!readRankings(instance.file, params))
+      return false;
+    calcParticipationBounds(params);
+    return true;
+  }
+  return setRatings(params, generateRatings(instance, params));
+}
+
+// Runs the phases from a fresh schedule, sampling the best schedule every
+// params.progressSeconds, at the end of each phase and once the run ends
+static bool runOnce(const Params& params, s32 seed, vector<Sample>& samples) {
+  Params runParams = params;
+  runParams.seed = seed;
+  Schedule measured(runParams);
+  vector<ID> ids;
+  double sampling = 0; // Seconds spent sampling, left out of the run's time
+  u64 doneIters = 0, lastIter = 0;
+  size_t lastPhase = 0;
+  time_point startTime = chrono::system_clock::now();
+
+  auto sample = [&](const Schedule& best, u64 iter, size_t phase) {
+    time_point sampleStart = chrono::system_clock::now();
+    double seconds = elapsedSecs(startTime) - sampling;
+    // A new phase (or restart) counts its iterations from 0. runPhases
+    // reports each phase's final iteration, so lastIter is its full count.
+    if (phase != lastPhase || iter < lastIter)
+      doneIters += lastIter;
+    lastIter = iter;
+    lastPhase = phase;
+    best.getAllIDs(ids);
+    measured.setAllIDs(ids);
+    samples.push_back(Sample{seed, seconds, doneIters + iter, phase,
+                             SumHappinessScorer(measured, runParams).score(),
+                             MinHappinessBonusScorer(measured, runParams).calcMinPersonScore()});
+    sampling += elapsedSecs(sampleStart);
+  };
+  runParams.onProgress = [&](const Progress& progress) {
+    sample(*progress.best, progress.iter, progress.phase);
+  };
+
+  Solver solver(runParams);
+  sample(solver.schedule(), 0, 0);
+  if (!solver.run())
+    return false;
+  sample(solver.schedule(), lastIter, lastPhase);
+  return true;
+}
+
+// Value of the run at the given point of the axis: that of the last sample
+// up to it, none (false) before the first
+template <typename Axis>
+static bool valueAt(const vector<Sample>& run, double x, Axis axis, Score Sample::* metric,
+                    double& value) {
+  auto it = upper_bound(run.begin(), run.end(), x,
+                        [&](double x, const Sample& s) { return x < axis(s); });
+  if (it == run.begin())
+    return false;
+  value = (*(it - 1)).*metric;
+  return true;
+}
+
+template <typename Axis>
+static void outputCurves(const InstanceResult& res, const string& axisName, Axis axis,
+                         s32 gridPoints, ostream& s) {
+  double end = 0;
+  for (const vector<Sample>& run : res.runs)
+    end = max(end, double(axis(run.back())));
+  for (s32 i = 0; i <= gridPoints; ++i) {
+    double x = end * i / gridPoints;
+    vector<double> scores, minHappiness;
+    for (const vector<Sample>& run : res.runs) {
+      double value;
+      if (valueAt(run, x, axis, &Sample::score, value))
+        scores.push_back(value);
+      if (valueAt(run, x, axis, &Sample::minHappiness, value))
+        minHappiness.push_back(value);
+    }
+    if (scores.empty())
+      continue;
+    Quartiles q = quartiles(scores), m = quartiles(minHappiness);
+    s << res.instance.name << "," << axisName << "," << x << "," << scores.size() << ","
+      << q.median << "," << q.q1 << "," << q.q3 << ","
+      << m.median << "," << m.q1 << "," << m.q3 << endl;
+  }
+}
+
+// Fraction of the upper bound the best score keeps on average over the
+// first horizon seconds, 0 before the first sample
+static double normalizedArea(const vector<Sample>& run, Score upperBound, double horizon) {
+  if (horizon <= 0)
+    return run.back().score / upperBound;
+  double area = 0;
+  for (size_t i = 0; i < run.size(); ++i) {
+    double next = i + 1 < run.size() ? run[i + 1].seconds : horizon;
+    area += run[i].score * max(0.0, min(next, horizon) - run[i].seconds);
+  }
+  return area / (upperBound * horizon);
+}
+
+static void outputQuartiles(const string& name, const vector<double>& values, ostream& s) {
+  Quartiles q = quartiles(values);
+  auto number = [&](double x) {
+    if (isfinite(x))
+      s << x;
+    else
+      s << "null";
+  };
+  s << "\"" << name << "\": {\"median\": ";
+  number(q.median);
+  s << ", \"q1\": ";
+  number(q.q1);
+  s << ", \"q3\": ";
+  number(q.q3);
+  s << "}";
+}
+
+static void outputSummary(const vector<InstanceResult>& results, double targetGap, ostream& s) {
+  s << setprecision(8) << "{" << endl
+    << "  \"target_gap\": " << targetGap << "," << endl
+    << "  \"instances\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const InstanceResult& res = results[i];
+    double target = (1 - targetGap) * res.upperBound;
+    double horizon = 0;
+    for (const vector<Sample>& run : res.runs)
+      horizon = max(horizon, run.back().seconds);
+    vector<double> scores, minHappiness, iters, seconds, timeToTarget, areas;
+    s32 reached = 0;
+    for (const vector<Sample>& run : res.runs) {
+      scores.push_back(run.back().score);
+      minHappiness.push_back(run.back().minHappiness);
+      iters.push_back(run.back().iter);
+      seconds.push_back(run.back().seconds);
+      auto it = find_if(run.begin(), run.end(), [&](const Sample& x) { return x.score >= target; });
+      timeToTarget.push_back(it == run.end() ? INF : it->seconds);
+      reached += it != run.end();
+      areas.push_back(normalizedArea(run, res.upperBound, horizon));
+    }
+    s << (i ? "," : "") << endl
+      << "    {\"name\": \"" << res.instance.name << "\", \"people\": " << res.nPeople
+      << ", \"abstracts\": " << res.nAbstracts << ", \"seeds\": " << res.runs.size()
+      << ", \"upper_bound\": " << res.upperBound << ", \"target\": " << target
+      << ", \"reached_target\": " << reached << "," << endl << "     ";
+    outputQuartiles("score", scores, s);
+    s << ", ";
+    outputQuartiles("min_happiness", minHappiness, s);
+    s << "," << endl << "     ";
+    outputQuartiles("iterations", iters, s);
+    s << ", ";
+    outputQuartiles("seconds", seconds, s);
+    s << "," << endl << "     ";
+    outputQuartiles("time_to_target", timeToTarget, s);
+    s << ", ";
+    outputQuartiles("auc", areas, s);
+    s << "}";
+  }
+  s << endl << "  ]" << endl << "}" << endl;
+}
+
+static bool writeResults(const vector<InstanceResult>& results, const string& dir,
+                         double targetGap, s32 gridPoints) {
+  boost::filesystem::create_directories(dir);
+  string samplesPath = (boost::filesystem::path(dir) / "bench_samples.csv").string();
+  ofstream samplesFile(samplesPath);
+  samplesFile << setprecision(8) << "instance,seed,seconds,iterations,phase,score,min_happiness" << endl;
+  for (const InstanceResult& res : results) {
+    for (const vector<Sample>& run : res.runs) {
+      for (const Sample& x : run)
+        samplesFile << res.instance.name << "," << x.seed << "," << x.seconds << "," << x.iter
+                    << "," << (x.phase + 1) << "," << x.score << "," << x.minHappiness << endl;
+    }
+  }
+  string curvesPath = (boost::filesystem::path(dir) / "bench_curves.csv").string();
+  ofstream curvesFile(curvesPath);
+  curvesFile << setprecision(8) << "instance,axis,x,runs,score_median,score_q1,score_q3,"
+             << "min_happiness_median,min_happiness_q1,min_happiness_q3" << endl;
+  for (const InstanceResult& res : results) {
+    outputCurves(res, "seconds", [](const Sample& x) { return x.seconds; }, gridPoints, curvesFile);
+    outputCurves(res, "iterations", [](const Sample& x) { return double(x.iter); }, gridPoints,
+                 curvesFile);
+  }
+  string summaryPath = (boost::filesystem::path(dir) / "bench_summary.json").string();
+  ofstream summaryFile(summaryPath);
+  outputSummary(results, targetGap, summaryFile);
+  return checkWritten(samplesFile, samplesPath) && checkWritten(curvesFile, curvesPath) &&
+         checkWritten(summaryFile, summaryPath);
+}
+
+static bool parseArgs(int argc, char** argv, Params& params, vector<BenchInstance>& instances,
+                      s32& nSeeds, s32& firstSeed, double& targetGap, s32& gridPoints) {
+  const Params defaults = defaultParams();
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "Show help message and exit")
+    ("instance", po::value<vector<string>>()->composing(), "Instance of the corpus, repeatable: comma separated key=value settings, name and either file (ratings CSV file) or people, abstracts, ratings (per person) and seed of generated ratings, then any of timeslots, rooms, room_size, participation_range, max_presentations. Defaults to the example and a generated instance of 1000 people")
+    ("seeds", po::value<int>()->default_value(5), "Runs per instance, with consecutive seeds")
+    ("first_seed", po::value<int>()->default_value(1), "Seed of the first run of each instance")
+    ("results_dir", po::value<string>()->default_value("bench_results"), "Directory for the samples, curves and summary")
+    ("sample_seconds", po::value<double>()->default_value(0.2), "Seconds between samples of the best schedule")
+    ("target_gap", po::value<double>()->default_value(0.1), "Time to target counts the time until the score is within this fraction of the upper bound")
+    ("grid_points", po::value<int>()->default_value(50), "Points of the curves along each axis")
+    ("iterations,i", po::value<u64>()->default_value(defaults.maxIterations), "Number of iterations per phase")
+    ("seconds", po::value<double>()->default_value(0), "Time limit per phase (0 for none)")
+    ("engine", po::value<string>()->default_value(defaults.engine), "Search engine of the annealing phases (sa, tabu, lns or descent)")
+    ("threads", po::value<int>()->default_value(defaults.threads), "Threads for annealing one chain")
+    ("init", po::value<string>()->default_value(defaults.initMethod), "Initial schedule method (flow or random)")
+    ("descent_moves", po::value<u64>()->default_value(defaults.descentMoves), "Moves evaluated by the steepest descent polishing after annealing (0 to disable)")
+    ("lns_rounds", po::value<u64>()->default_value(defaults.lnsRounds), "Number of large neighbourhood search repairs after annealing")
+    ("restarts", po::value<int>()->default_value(defaults.restarts), "Runs of the phases after the first")
+    ("phase", po::value<vector<string>>()->composing(), "Optimization phase, repeatable, as for alpine_scheduler")
+    ("verbose,v", "Verbose mode (for debugging)")
+    ;
+
+  try {
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+      cout << desc << "\n";
+      return false;
+    }
+    setVerboseMode(vm.count("verbose") > 0);
+    params = defaults;
+    params.resultsDir = "";
+    params.maxIterations = vm["iterations"].as<u64>();
+    params.maxSeconds = vm["seconds"].as<double>();
+    params.engine = vm["engine"].as<string>();
+    if (!isEngine(params.engine)) {
+      err() << "engine should be 'sa', 'tabu', 'lns' or 'descent'. Got: " << params.engine << endl;
+      return false;
+    }
+    params.threads = vm["threads"].as<int>();
+    params.initMethod = vm["init"].as<string>();
+    if (params.initMethod != "flow" && params.initMethod != "random") {
+      err() << "init should be 'flow' or 'random'. Got: " << params.initMethod << endl;
+      return false;
+    }
+    params.descentMoves = vm["descent_moves"].as<u64>();
+    params.lnsRounds = vm["lns_rounds"].as<u64>();
+    params.restarts = vm["restarts"].as<int>();
+    params.progressSeconds = vm["sample_seconds"].as<double>();
+    if (params.progressSeconds <= 0) {
+      err() << "sample_seconds should be positive" << endl;
+      return false;
+    }
+    Phase phaseDefaults{params.engine, 1, 0, 0, "log", params.maxIterations, params.maxSeconds,
+                        params.initTemp, params.finalTemp, params.autoTemp};
+    if (vm.count("phase")) {
+      for (const string& spec : vm["phase"].as<vector<string>>()) {
+        Phase phase = phaseDefaults;
+        if (!parsePhase(spec, phase))
+          return false;
+        params.phases.push_back(phase);
+      }
+    }
+    if (params.phases.empty()) {
+      params.phases = defaultPhases(params);
+      for (Phase& phase : params.phases)
+        phase.maxSeconds = params.maxSeconds;
+    }
+
+    nSeeds = vm["seeds"].as<int>();
+    firstSeed = vm["first_seed"].as<int>();
+    targetGap = vm["target_gap"].as<double>();
+    gridPoints = vm["grid_points"].as<int>();
+    if (nSeeds < 1 || gridPoints < 1) {
+      err() << "seeds and grid_points should be at least 1" << endl;
+      return false;
+    }
+    params.resultsDir = vm["results_dir"].as<string>();
+
+    Scenario defaultScenario{params.nTimeslots, params.nRooms, params.roomSize,
+                             params.participationRange, params.maxPresentations};
+    vector<string> specs{"name=example,file=data/example/rating_example.csv",
+                         "name=generated_1000,people=1000,abstracts=600,ratings=20,rooms=40"};
+    if (vm.count("instance"))
+      specs = vm["instance"].as<vector<string>>();
+    for (const string& spec : specs) {
+      BenchInstance instance;
+      if (!parseInstance(spec, defaultScenario, instance))
+        return false;
+      instances.push_back(instance);
+    }
+  } catch(po::error& e) {
+    cout << "Error parsing command line: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Params params;
+  vector<BenchInstance> instances;
+  s32 nSeeds, firstSeed, gridPoints;
+  double targetGap;
+  if (!parseArgs(argc, argv, params, instances, nSeeds, firstSeed, targetGap, gridPoints))
+    return 2;
+  string resultsDir = params.resultsDir;
+  params.resultsDir = ""; // Runs keep their schedules in memory
+  try {
+    vector<InstanceResult> results;
+    for (const BenchInstance& instance : instances) {
+      Params instParams;
+      if (!instanceParams(instance, params, instParams) || !checkFeasibility(instParams))
+        return 1;
+      InstanceResult res{instance, instParams.nPeople, instParams.nAbstracts,
+                         sharedAssignmentBound(instParams), {}};
+      info() << "Instance " << instance.name << ": " << res.nPeople << " people, "
+             << res.nAbstracts << " abstracts, upper bound " << res.upperBound << endl;
+      for (s32 seed = firstSeed; seed < firstSeed + nSeeds; ++seed) {
+        res.runs.emplace_back();
+        if (!runOnce(instParams, seed, res.runs.back()))
+          return 1;
+        const Sample& last = res.runs.back().back();
+        info() << "  seed " << seed << ": score " << last.score << " min happiness "
+               << last.minHappiness << " in " << last.seconds << " s, "
+               << last.iter << " iterations" << endl;
+      }
+      results.push_back(res);
+    }
+    if (!writeResults(results, resultsDir, targetGap, gridPoints))
+      return 1;
+    info() << "Wrote the samples, curves and summary to " << resultsDir << endl;
+  } catch (const std::exception& e) {
+    err() << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
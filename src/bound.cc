@@ -0,0 +1,74 @@
+#include "bound.hh"
+#include "flow.hh"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+
+static s32 maxPersonListens(const Options& params) {
+  return min(static_cast<s32>(params.maxParticipations), params.nTimeslots);
+}
+
+Score topRatingsBound(const Options& params) {
+  const s32 k = maxPersonListens(params);
+  Score bound = 0;
+  vector<Score> personScores;
+  for (ID personID = 0; personID < params.nPeople; ++personID) {
+    personScores.clear();
+    for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID)
+      personScores.push_back(getRanking(personID, abstractID, params));
+    s32 n = min(k, static_cast<s32>(personScores.size()));
+    partial_sort(personScores.begin(), personScores.begin() + n, personScores.end(),
+                 greater<Score>());
+    for (s32 i = 0; i < n; ++i)
+      bound += max(Score(0), personScores[i]);
+  }
+  return bound;
+}
+
+Score assignmentBound(const Options& params) {
+  // source -> person -> abstract -> seats -> sink
+  const s32 source = 0;
+  const s32 firstPerson = 1;
+  const s32 firstAbstract = firstPerson + params.nPeople;
+  const s32 seats = firstAbstract + params.nAbstracts;
+  const s32 sink = seats + 1;
+  MinCostFlow flow(sink + 1);
+  for (ID personID = 0; personID < params.nPeople; ++personID)
+    flow.addEdge(source, firstPerson + personID, maxPersonListens(params), 0);
+  // Normalization gives unrated pairs a tiny score. Leaving them out of the
+  // flow keeps it small, every seat can add at most the largest of them.
+  const Score filler = fillerScore(params);
+  Score maxFillerScore = 0;
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+    for (ID personID = 0; personID < params.nPeople; ++personID) {
+      Score score = getRanking(personID, abstractID, params);
+      if (score > filler)
+        flow.addEdge(firstPerson + personID, firstAbstract + abstractID, 1, -score);
+      else
+        maxFillerScore = max(maxFillerScore, score);
+    }
+    flow.addEdge(firstAbstract + abstractID, seats,
+                 params.maxPresentations * (params.roomSize - 1), 0);
+  }
+  const s32 nSeats = params.nTimeslots * params.nRooms * (params.roomSize - 1);
+  flow.addEdge(seats, sink, nSeats, 0);
+  s32 totalFlow;
+  return -flow.solve(source, sink, numeric_limits<s32>::max(), true, totalFlow) +
+         nSeats * maxFillerScore;
+}
+
+Score sharedAssignmentBound(const Options& params) {
+  BoundCache& cache = *params.instance->bounds;
+  auto shape = make_tuple(params.nTimeslots, params.nRooms, params.roomSize,
+                          params.maxParticipations, params.maxPresentations);
+  // Held while solving, so that concurrent callers wait for the one bound
+  lock_guard<mutex> lock(cache.mutex);
+  auto it = cache.assignment.find(shape);
+  if (it == cache.assignment.end())
+    it = cache.assignment.emplace(shape, assignmentBound(params)).first;
+  return it->second;
+}
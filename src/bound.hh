@@ -0,0 +1,22 @@
+#pragma once
+
+#include "defs.hh"
+#include "params.hh"
+
+
+// Upper bounds on the sum of the ratings people get for the abstracts they
+// hear.
+
+// Every person hears at most maxParticipations abstracts, at best their
+// highest rated ones
+Score topRatingsBound(const Options& params);
+
+// Relaxation keeping the participation and presentation limits but not the
+// timeslots: an assignment of people to abstracts where each person hears
+// up to maxParticipations abstracts, each abstract has up to
+// maxPresentations * (roomSize - 1) listeners and all listeners fit in the
+// seats. Solved exactly as a min cost flow, never above topRatingsBound.
+Score assignmentBound(const Options& params);
+// assignmentBound computed once per instance and event shape, whichever
+// copy of the params (or thread) asks first
+Score sharedAssignmentBound(const Options& params);
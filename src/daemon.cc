@@ -0,0 +1,212 @@
+#include "daemon.hh"
+#include "feasibility.hh"
+#include "pipeline.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+Daemon::Daemon(const Params& params) : m_params(params), m_shutdown(false) {
+  rebuildSchedule(false);
+}
+
+bool Daemon::serve(const string& socketPath) {
+  sockaddr_un addr;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    err() << "Socket path too long: " << socketPath << endl;
+    return false;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    err() << "Error creating socket: " << strerror(errno) << endl;
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(socketPath.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+    err() << "Error listening on '" << socketPath << "': " << strerror(errno) << endl;
+    close(fd);
+    return false;
+  }
+  info() << "Listening on " << socketPath << endl;
+  bool ok = true;
+  while (!m_shutdown) {
+    int client = accept(fd, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+      err() << "Error accepting connection: " << strerror(errno) << endl;
+      ok = false;
+      break;
+    }
+    serveClient(client);
+    close(client);
+  }
+  close(fd);
+  unlink(socketPath.c_str());
+  return ok;
+}
+
+static bool sendAll(int fd, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+void Daemon::serveClient(int fd) {
+  string buffer;
+  char chunk[4096];
+  while (!m_shutdown) {
+    size_t eol = buffer.find('\n');
+    if (eol == string::npos) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return;
+      buffer.append(chunk, n);
+      continue;
+    }
+    string line = boost::trim_copy(buffer.substr(0, eol));
+    buffer.erase(0, eol + 1);
+    if (line.empty())
+      continue;
+    ostringstream out;
+    string error;
+    if (handleCommand(line, out, error))
+      out << "OK" << endl;
+    else
+      out << "ERROR " << error << endl;
+    if (!sendAll(fd, out.str()))
+      return;
+  }
+}
+
+bool Daemon::handleCommand(const string& line, ostream& out, string& error) {
+  vector<string> args;
+  boost::split(args, line, boost::is_any_of(" \t"), boost::token_compress_on);
+  const string& cmd = args[0];
+  dbg() << "Command: " << line << endl;
+  try {
+    if (cmd == "rating" && args.size() == 4) {
+      return updateRating(stoi(args[1]), stoi(args[2]), false, stoi(args[3]), error);
+    } else if (cmd == "remove_rating" && args.size() == 3) {
+      return updateRating(stoi(args[1]), stoi(args[2]), true, 0, error);
+    } else if ((cmd == "timeslots" || cmd == "rooms" || cmd == "room_size") && args.size() == 2) {
+      s32 n = stoi(args[1]);
+      if (n < (cmd == "room_size" ? 2 : 1)) {
+        error = "Bad " + cmd + ": " + args[1];
+        return false;
+      }
+      if (cmd == "timeslots")
+        m_params.nTimeslots = n;
+      else if (cmd == "rooms")
+        m_params.nRooms = n;
+      else
+        m_params.roomSize = n;
+      // Normalization depends on the number of timeslots
+      if (!prepareRankings(m_params)) {
+        error = "Failed preparing rankings";
+        return false;
+      }
+      calcParticipationBounds(m_params);
+      rebuildSchedule(false);
+      return true;
+    } else if (cmd == "run") {
+      u64 iterations = 0;
+      double seconds = 0;
+      for (size_t i = 1; i < args.size(); ++i) {
+        if (boost::starts_with(args[i], "iterations=")) {
+          iterations = stod(args[i].substr(11));
+        } else if (boost::starts_with(args[i], "seconds=")) {
+          seconds = stod(args[i].substr(8));
+        } else {
+          error = "Unknown run setting: " + args[i];
+          return false;
+        }
+      }
+      FeasibilityReport feasibility = analyzeFeasibility(m_params);
+      if (!feasibility.feasible()) {
+        error = "Infeasible: " + feasibility.binding().name;
+        return false;
+      }
+      if (!run(iterations, seconds)) {
+        error = "Optimization failed";
+        return false;
+      }
+      out << "Score: " << SumHappinessScorer(*m_sched, m_params).score() << endl;
+      return true;
+    } else if (cmd == "schedule" && args.size() == 1) {
+      m_sched->output(out);
+      return true;
+    } else if (cmd == "stats" && args.size() == 1) {
+      m_sched->stats().output(out);
+      out << "Score: " << SumHappinessScorer(*m_sched, m_params).score() << endl;
+      return true;
+    } else if (cmd == "shutdown" && args.size() == 1) {
+      m_shutdown = true;
+      return true;
+    }
+  } catch (const std::exception& e) {
+    error = string("Bad argument: ") + e.what();
+    return false;
+  }
+  error = "Unknown command: " + line;
+  return false;
+}
+
+bool Daemon::updateRating(ID origPersonID, ID origAbstractID, bool remove, Score score,
+                          string& error) {
+  auto key = make_pair(origPersonID, origAbstractID);
+  if (remove) {
+    if (editInstance(m_params)->origRankings.erase(key) == 0) {
+      error = "No such rating";
+      return false;
+    }
+  } else {
+    // As read from the rankings file
+    score = min(max(score, m_params.minScore), m_params.maxScore) + m_params.scoreDelta;
+    editInstance(m_params)->origRankings[key] = score;
+  }
+  vector<ID> prevPeople = m_params.instance->personIdToOrig;
+  vector<ID> prevAbstracts = m_params.instance->abstractIdToOrig;
+  if (!prepareRankings(m_params)) {
+    error = "Failed preparing rankings";
+    return false;
+  }
+  calcParticipationBounds(m_params);
+  rebuildSchedule(prevPeople == m_params.instance->personIdToOrig &&
+                  prevAbstracts == m_params.instance->abstractIdToOrig);
+  return true;
+}
+
+bool Daemon::run(u64 iterations, double seconds) {
+  return runPhases(*m_sched, withBudget(m_params, iterations, seconds));
+}
+
+void Daemon::rebuildSchedule(bool keepIDs) {
+  vector<ID> ids;
+  if (keepIDs && m_sched)
+    m_sched->getAllIDs(ids);
+  m_sched.reset(new Schedule(m_params));
+  if (ids.empty())
+    m_sched->initState();
+  else
+    m_sched->setAllIDs(ids);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "params.hh"
+#include "schedule.hh"
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+
+// Keeps the ratings and the best schedule in memory between requests, served
+// over a Unix domain socket. The protocol is line based: each request is a
+// command line, answered by its output lines and a final "OK" or
+// "ERROR <message>" line. Commands:
+//   rating <person_id> <abstract_id> <score>   Adds or updates a rating
+//   remove_rating <person_id> <abstract_id>
+//   timeslots <n> / rooms <n> / room_size <n>  Changes the event's shape
+//   run [iterations=<n>] [seconds=<s>]         Runs the phases again, from
+//                                              the current best schedule
+//   schedule                                   Best schedule CSV
+//   stats                                      Its statistics and score
+//   shutdown
+// Rating changes keep the schedule while the people and abstracts stay the
+// same. Other changes start over from a new initial schedule.
+class Daemon final {
+public:
+  explicit Daemon(const Params& params);
+
+  // Serves clients one at a time until shutdown. Returns false on socket
+  // errors.
+  bool serve(const std::string& socketPath);
+
+  // Handles one command line, writing the response without the status line.
+  // Returns false with an error message for bad commands.
+  bool handleCommand(const std::string& line, std::ostream& out, std::string& error);
+
+protected:
+  Params m_params;
+  std::unique_ptr<Schedule> m_sched;
+  bool m_shutdown;
+
+  void serveClient(int fd);
+  bool updateRating(ID origPersonID, ID origAbstractID, bool remove, Score score,
+                    std::string& error);
+  bool run(u64 iterations, double seconds);
+  // Rebuilds the schedule after m_params changed. Keeps the seating if the
+  // event's shape and the people and abstracts didn't change.
+  void rebuildSchedule(bool keepIDs);
+};
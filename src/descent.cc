@@ -0,0 +1,392 @@
+#include "descent.hh"
+
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+
+static const Score NO_GAIN = -numeric_limits<Score>::infinity();
+
+SteepestDescent::SteepestDescent(Schedule& sched, const Options& params, Scorer& scorer,
+                                 ScorerFactory scorerFactory) :
+  Optimizer(sched, params, scorer), m_scorerFactory(scorerFactory),
+  m_rankings(m_params.instance->rankings),
+  m_nThreads(max(1, min(params.threads, params.nTimeslots))),
+  m_tolerance(params.minNormScore / 1000), m_nImproved(0), m_nRejected(0),
+  m_localOptimum(false) {}
+
+bool SteepestDescent::run() {
+  m_startTime = chrono::system_clock::now();
+  m_bestScore = m_scorer.score();
+  handleNewBest();
+  if (m_nThreads > 1 && !descendInParallel())
+    return false;
+  // The threads' bounds are tighter than the schedule's, so only a descent
+  // on the whole schedule ends at its local optimum
+  if (!descend(true))
+    return false;
+  if (m_localOptimum)
+    info() << "Steepest descent reached a local optimum" << endl;
+  return outputStatus(info());
+}
+
+bool SteepestDescent::descend(bool trackBest) {
+  m_localOptimum = false;
+  m_owned = m_timeslots;
+  if (m_owned.empty()) {
+    for (s32 t = 0; t < m_params.nTimeslots; ++t)
+      m_owned.push_back(t);
+  }
+  m_isOwned.assign(m_params.nTimeslots, false);
+  for (s32 t : m_owned)
+    m_isOwned[t] = true;
+
+  double nextOutputSec = 0;
+  for (;;) {
+    buildTables();
+    u64 nImproved = 0, nRejected = 0;
+    Move move;
+    Score gain;
+    for (;;) {
+      if (m_iter >= m_params.maxIterations)
+        return true;
+      if (m_iter % 64 == 0) {
+        if (trackBest && elapsedSecs(m_startTime) >= nextOutputSec) {
+          if (!outputStatus(dbg()))
+            return false;
+          nextOutputSec += m_params.progressSeconds;
+        }
+        // Only improving moves are applied, so the schedule is the best one
+        if (reachedStopCondition())
+          return true;
+      }
+      if (!bestMove(move, gain))
+        break;
+      ++m_iter;
+      Score prevScore = m_scorer.score();
+      if (applyListenerMove(move)) {
+        if (m_scorer.score() > prevScore + m_tolerance) {
+          ++m_nImproved;
+          ++nImproved;
+          updateAfterMove(move);
+          if (trackBest) {
+            m_bestScore = m_scorer.score();
+            if (!handleNewBest())
+              return false;
+          }
+          continue;
+        }
+        undoMove(move);
+      }
+      rejectMove(move);
+      ++nRejected;
+    }
+    // Moves rejected before the last improvement may have become improving
+    if (nRejected == 0 || nImproved == 0) {
+      m_localOptimum = true;
+      return true;
+    }
+  }
+}
+
+bool SteepestDescent::descendInParallel() {
+  Options threadParams = m_params;
+  threadParams.threads = 1;
+  threadParams.maxIterations = m_params.maxIterations / m_nThreads;
+  // Timeslots round robin, the first thread getting the first one
+  vector<vector<s32>> timeslots(m_nThreads);
+  vector<s32> timeslotThread(m_params.nTimeslots);
+  for (s32 t = 0; t < m_params.nTimeslots; ++t) {
+    timeslots[t % m_nThreads].push_back(t);
+    timeslotThread[t] = t % m_nThreads;
+  }
+
+  vector<unique_ptr<Schedule>> scheds;
+  vector<unique_ptr<Scorer>> scorers;
+  vector<unique_ptr<SteepestDescent>> workers;
+  for (s32 k = 0; k < m_nThreads; ++k) {
+    scheds.emplace_back(new Schedule(m_sched));
+    limitToThread(m_sched, *scheds[k], m_params, k, m_nThreads, timeslotThread, 0);
+    scorers.push_back(m_scorerFactory(*scheds[k]));
+    workers.emplace_back(new SteepestDescent(*scheds[k], threadParams, *scorers[k],
+                                             m_scorerFactory));
+    workers[k]->restrictTimeslots(timeslots[k]);
+    workers[k]->m_startTime = m_startTime;
+  }
+
+  vector<thread> threads;
+  vector<char> succeeded(m_nThreads, false);
+  for (s32 k = 0; k < m_nThreads; ++k)
+    threads.emplace_back([&, k]() { succeeded[k] = workers[k]->descend(false); });
+  for (thread& th : threads)
+    th.join();
+
+  vector<ID> prevIDs, ids, threadIDs;
+  m_sched.getAllIDs(prevIDs);
+  ids = prevIDs;
+  const s32 timeslotSize = m_params.nRooms * m_params.roomSize;
+  u64 nImproved = 0;
+  for (s32 k = 0; k < m_nThreads; ++k) {
+    if (!succeeded[k])
+      return false;
+    scheds[k]->getAllIDs(threadIDs);
+    for (s32 t : timeslots[k]) {
+      copy(threadIDs.begin() + t * timeslotSize, threadIDs.begin() + (t + 1) * timeslotSize,
+           ids.begin() + t * timeslotSize);
+    }
+    m_iter += workers[k]->m_iter;
+    nImproved += workers[k]->m_nImproved;
+    m_nRejected += workers[k]->m_nRejected;
+  }
+  m_sched.setAllIDs(ids);
+  m_scorer.recalcScore();
+  // Each thread only sees the score of its own changes. A score not
+  // separable by timeslot (of the least satisfied person) can drop with
+  // the changes of several threads together.
+  if (m_scorer.score() < m_bestScore - m_tolerance) {
+    dbg() << "Discarding the parallel descent, which lowered the score to "
+          << m_scorer.score() << endl;
+    m_sched.setAllIDs(prevIDs);
+    m_scorer.recalcScore();
+    return true;
+  }
+  m_nImproved += nImproved;
+  if (m_scorer.score() > m_bestScore) {
+    m_bestScore = m_scorer.score();
+    return handleNewBest();
+  }
+  return true;
+}
+
+Score SteepestDescent::rating(ID personID, s32 timeslot, s32 room) {
+  ID abstractID = m_sched.getAbstractID(timeslot, room);
+  if (invalidID(abstractID) || invalidID(personID))
+    return 0;
+  return getRanking(personID, abstractID, m_rankings, m_params.nPeople);
+}
+
+bool SteepestDescent::canEnter(s32 timeslot, ID personID, s32 room) {
+  if (!m_sched.isFreeID(timeslot, personID) || !m_sched.isAvailable(timeslot, personID) ||
+      m_sched.getPersonCount(personID) >= m_sched.getMaxPersonCount(personID) ||
+      isRejected(timeslot, personID, room))
+    return false;
+  ID abstractID = m_sched.getAbstractID(timeslot, room);
+  return invalidID(abstractID) || !m_sched.testPersonAbstract(personID, abstractID);
+}
+
+void SteepestDescent::buildTables() {
+  const s32 nRooms = m_params.nRooms;
+  m_roomMoves.resize(size_t(m_params.nTimeslots) * nRooms * nRooms);
+  m_entering.resize(m_params.nTimeslots * nRooms);
+  m_leaving.resize(m_params.nTimeslots * nRooms);
+  m_timeslotGain.assign(m_params.nTimeslots, NO_GAIN);
+  m_timeslotMove.resize(m_params.nTimeslots);
+  m_dirty.assign(m_params.nTimeslots, true);
+  m_rejected.resize(size_t(m_params.nTimeslots) * m_params.nPeople * nRooms);
+  m_rejected.reset();
+  for (s32 t : m_owned) {
+    for (s32 r = 0; r < nRooms; ++r) {
+      updateRoomMoves(t, r);
+      updateEntering(t, r);
+      updateLeaving(t, r);
+    }
+  }
+}
+
+void SteepestDescent::updateRoomMoves(s32 timeslot, s32 room) {
+  const s32 nRooms = m_params.nRooms;
+  Candidate* row = &m_roomMoves[(size_t(timeslot) * nRooms + room) * nRooms];
+  fill(row, row + nRooms, Candidate{NO_GAIN, -1, INVALID_ID});
+  for (s32 seat = 1; seat < m_params.roomSize; ++seat) {
+    ID personID = m_sched.getID(timeslot, room, seat);
+    if (invalidID(personID)) {
+      // An empty seat takes a listener of the other room for nothing
+      for (s32 to = 0; to < nRooms; ++to) {
+        if (to != room && row[to].gain < 0)
+          row[to] = Candidate{0, seat, INVALID_ID};
+      }
+      continue;
+    }
+    Score base = rating(personID, timeslot, room);
+    for (s32 to = 0; to < nRooms; ++to) {
+      if (to == room || isRejected(timeslot, personID, to))
+        continue;
+      ID abstractID = m_sched.getAbstractID(timeslot, to);
+      if (validID(abstractID) && m_sched.testPersonAbstract(personID, abstractID))
+        continue;
+      Score gain = rating(personID, timeslot, to) - base;
+      if (gain > row[to].gain)
+        row[to] = Candidate{gain, seat, personID};
+    }
+  }
+  m_dirty[timeslot] = true;
+}
+
+void SteepestDescent::updateEntering(s32 timeslot, s32 room) {
+  Candidate& best = m_entering[timeslot * m_params.nRooms + room];
+  best = Candidate{NO_GAIN, -1, INVALID_ID};
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    if (!canEnter(timeslot, personID, room))
+      continue;
+    Score gain = rating(personID, timeslot, room);
+    if (gain > best.gain)
+      best = Candidate{gain, -1, personID};
+  }
+  m_dirty[timeslot] = true;
+}
+
+void SteepestDescent::updateLeaving(s32 timeslot, s32 room) {
+  Candidate& best = m_leaving[timeslot * m_params.nRooms + room];
+  best = Candidate{NO_GAIN, -1, INVALID_ID};
+  for (s32 seat = 1; seat < m_params.roomSize; ++seat) {
+    ID personID = m_sched.getID(timeslot, room, seat);
+    if (validID(personID) &&
+        (m_sched.getPersonCount(personID) <= m_sched.getMinPersonCount(personID) ||
+         isRejected(timeslot, personID, room)))
+      continue;
+    Score gain = -rating(personID, timeslot, room);
+    if (gain > best.gain)
+      best = Candidate{gain, seat, personID};
+  }
+  m_dirty[timeslot] = true;
+}
+
+void SteepestDescent::updatePerson(ID personID) {
+  for (s32 t : m_owned) {
+    s32 room, seat;
+    if (m_sched.findPerson(t, personID, room, seat)) {
+      if (seat > 0) {
+        updateRoomMoves(t, room);
+        updateLeaving(t, room);
+      }
+      continue;
+    }
+    for (s32 r = 0; r < m_params.nRooms; ++r) {
+      Candidate& best = m_entering[t * m_params.nRooms + r];
+      if (best.personID == personID) {
+        updateEntering(t, r);
+      } else if (canEnter(t, personID, r) && rating(personID, t, r) > best.gain) {
+        best = Candidate{rating(personID, t, r), -1, personID};
+        m_dirty[t] = true;
+      }
+    }
+  }
+}
+
+void SteepestDescent::updateTimeslotBest(s32 timeslot) {
+  const s32 nRooms = m_params.nRooms;
+  const Candidate* moves = &m_roomMoves[size_t(timeslot) * nRooms * nRooms];
+  Score best = NO_GAIN;
+  Move& move = m_timeslotMove[timeslot];
+  for (s32 r1 = 0; r1 < nRooms; ++r1) {
+    for (s32 r2 = r1 + 1; r2 < nRooms; ++r2) {
+      const Candidate& c1 = moves[r1 * nRooms + r2];
+      const Candidate& c2 = moves[r2 * nRooms + r1];
+      Score gain = c1.gain + c2.gain;
+      if (gain > best && (validID(c1.personID) || validID(c2.personID))) {
+        best = gain;
+        move = Move{timeslot, r1, c1.seat, r2, c2.seat, c1.personID, c2.personID};
+      }
+    }
+    const Candidate& entering = m_entering[timeslot * nRooms + r1];
+    const Candidate& leaving = m_leaving[timeslot * nRooms + r1];
+    Score gain = entering.gain + leaving.gain;
+    if (gain > best) {
+      best = gain;
+      move = Move{timeslot, r1, leaving.seat, -1, -1, leaving.personID, entering.personID};
+    }
+  }
+  m_timeslotGain[timeslot] = best;
+  m_dirty[timeslot] = false;
+}
+
+bool SteepestDescent::bestMove(Move& move, Score& gain) {
+  gain = NO_GAIN;
+  for (s32 t : m_owned) {
+    if (m_dirty[t])
+      updateTimeslotBest(t);
+    if (m_timeslotGain[t] > gain) {
+      gain = m_timeslotGain[t];
+      move = m_timeslotMove[t];
+    }
+  }
+  return gain > m_tolerance;
+}
+
+bool SteepestDescent::applyListenerMove(const Move& move) {
+  if (!move.isSwap())
+    return applyMove(move);
+  s32 t = move.timeslot;
+  ID abstractID1 = m_sched.getAbstractID(t, move.room1);
+  ID abstractID2 = m_sched.getAbstractID(t, move.room2);
+  if ((validID(move.id1) && validID(abstractID2) &&
+       m_sched.testPersonAbstract(move.id1, abstractID2)) ||
+      (validID(move.id2) && validID(abstractID1) &&
+       m_sched.testPersonAbstract(move.id2, abstractID1)))
+    return false;
+  m_scorer.prepareSwapChange(t, move.room1, move.seat1, t, move.room2, move.seat2);
+  m_sched.setIDUnsafe(t, move.room2, move.seat2, INVALID_ID);
+  m_sched.setIDUnsafe(t, move.room1, move.seat1, move.id2);
+  m_sched.setIDUnsafe(t, move.room2, move.seat2, move.id1);
+  m_scorer.tryChange();
+  return true;
+}
+
+void SteepestDescent::updateAfterMove(const Move& move) {
+  s32 t = move.timeslot;
+  updateRoomMoves(t, move.room1);
+  updateLeaving(t, move.room1);
+  if (move.isSwap()) {
+    updateRoomMoves(t, move.room2);
+    updateLeaving(t, move.room2);
+  } else {
+    // The newly seated person is no longer free in the timeslot
+    for (s32 r = 0; r < m_params.nRooms; ++r) {
+      if (m_entering[t * m_params.nRooms + r].personID == move.id2)
+        updateEntering(t, r);
+    }
+  }
+  // Their counts and heard abstracts changed, for all timeslots
+  if (validID(move.id1))
+    updatePerson(move.id1);
+  if (validID(move.id2))
+    updatePerson(move.id2);
+}
+
+void SteepestDescent::rejectMove(const Move& move) {
+  ++m_nRejected;
+  s32 t = move.timeslot;
+  // Rejects the person whose own rating gains least, the likeliest to have
+  // lowered the score: a listener making way is kept in their room
+  if (!move.isSwap()) {
+    if (validID(move.id1)) {
+      reject(t, move.id1, move.room1);
+      updateLeaving(t, move.room1);
+    } else {
+      reject(t, move.id2, move.room1);
+      updateEntering(t, move.room1);
+    }
+    return;
+  }
+  const s32 nRooms = m_params.nRooms;
+  Score gain1 = m_roomMoves[(size_t(t) * nRooms + move.room1) * nRooms + move.room2].gain;
+  Score gain2 = m_roomMoves[(size_t(t) * nRooms + move.room2) * nRooms + move.room1].gain;
+  if (validID(move.id1) && (invalidID(move.id2) || gain1 <= gain2)) {
+    reject(t, move.id1, move.room2);
+    updateRoomMoves(t, move.room1);
+  } else {
+    reject(t, move.id2, move.room1);
+    updateRoomMoves(t, move.room2);
+  }
+}
+
+bool SteepestDescent::outputStatus(ostream& s) {
+  s << "Descent move " << double(m_iter) << "/" << double(m_params.maxIterations)
+    << " improving: " << m_nImproved << " rejected: " << m_nRejected << setprecision(4)
+    << " score: " << m_scorer.score() << " best so far:" << m_bestScore;
+  outputGap(s) << endl;
+  reportProgress();
+  return saveBest();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "optimizer.hh"
+#include "parallel.hh"
+
+#include <boost/dynamic_bitset.hpp>
+
+
+// Steepest descent over the listener moves, for polishing an annealed
+// schedule: a listener moves to another room of the timeslot by a swap, or
+// makes way for a free person. Presenters stay put, so the change of the
+// sum of ratings of every move is kept in tables, and a move only updates
+// the entries of the rooms and people it touches. Applies the move with the
+// best gain as long as it improves the scorer's score, which ends at a
+// local optimum of the listener moves. Moves raising the sum but not the
+// score (of phases with fairness weights) are rejected until the next pass
+// over the tables. With several threads, first descends on the timeslots
+// split between threads as ParallelAnnealing does, then on the whole
+// schedule.
+class SteepestDescent final : public Optimizer {
+public:
+  SteepestDescent(Schedule& sched, const Options& params, Scorer& scorer,
+                  ScorerFactory scorerFactory);
+
+  virtual bool run() override;
+
+  // Descends on the timeslots (all if not restricted) until a local optimum,
+  // the iterations run out or the stop condition
+  bool descend(bool trackBest);
+  bool reachedLocalOptimum() const { return m_localOptimum; }
+
+protected:
+  ScorerFactory m_scorerFactory;
+  const Rankings& m_rankings;
+  s32 m_nThreads;
+  const Score m_tolerance;
+  u64 m_nImproved, m_nRejected;
+  bool m_localOptimum;
+
+  // The best listener (or empty seat) to move from a room to another, the
+  // best free person to seat in a room, or the least rated listener (or
+  // empty seat) to make way, with their change of the sum of ratings
+  struct Candidate {
+    Score gain; // -infinity if none
+    s32 seat;
+    ID personID;
+  };
+  std::vector<s32> m_owned;                 // Timeslots descended on
+  std::vector<bool> m_isOwned;              // [timeslot]
+  std::vector<Candidate> m_roomMoves;       // [(timeslot * nRooms + from) * nRooms + to]
+  std::vector<Candidate> m_entering;        // [timeslot * nRooms + room]
+  std::vector<Candidate> m_leaving;         // [timeslot * nRooms + room]
+  std::vector<Score> m_timeslotGain;        // Best move of the timeslot
+  std::vector<Move> m_timeslotMove;
+  std::vector<bool> m_dirty;                // Best move of the timeslot outdated
+  // Rejected moves of a person to a room, or out of their own room making
+  // way: [(timeslot * nPeople + person) * nRooms + room]
+  boost::dynamic_bitset<> m_rejected;
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Improving moves: " << m_nImproved << std::endl;
+    s << "Rejected moves: " << m_nRejected << std::endl;
+    s << "Local optimum: " << m_localOptimum << std::endl;
+  }
+
+  Score rating(ID personID, s32 timeslot, s32 room);
+  bool isRejected(s32 timeslot, ID personID, s32 room) {
+    return m_rejected.test((size_t(timeslot) * m_params.nPeople + personID) * m_params.nRooms + room);
+  }
+  void reject(s32 timeslot, ID personID, s32 room) {
+    m_rejected.set((size_t(timeslot) * m_params.nPeople + personID) * m_params.nRooms + room);
+  }
+  bool canEnter(s32 timeslot, ID personID, s32 room);
+  void buildTables();
+  void updateRoomMoves(s32 timeslot, s32 room);
+  void updateEntering(s32 timeslot, s32 room);
+  void updateLeaving(s32 timeslot, s32 room);
+  // After the person's count or heard abstracts changed
+  void updatePerson(ID personID);
+  void updateTimeslotBest(s32 timeslot);
+  // The move with the best gain, false if none raises the sum
+  bool bestMove(Move& move, Score& gain);
+  void updateAfterMove(const Move& move);
+  void rejectMove(const Move& move);
+  // Listener swaps keep both counts, which the seat by seat checks of
+  // swapIfLegal don't see: they fail for people at their minimum count
+  bool applyListenerMove(const Move& move);
+
+  bool descendInParallel();
+  bool outputStatus(std::ostream& s);
+};
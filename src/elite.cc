@@ -0,0 +1,312 @@
+#include "elite.hh"
+#include "optimizer.hh"
+#include "pipeline.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+
+Elite makeElite(const Params& params, const vector<ID>& ids, Score score, s32 run) {
+  Elite res{ids, vector<ID>(params.nTimeslots * params.nPeople, INVALID_ID), score, run};
+  size_t i = 0;
+  for (s32 t = 0; t < params.nTimeslots; ++t) {
+    for (s32 r = 0; r < params.nRooms; ++r) {
+      ID abstractID = ids[i];
+      for (s32 s = 0; s < params.roomSize; ++s, ++i) {
+        if (validID(ids[i]))
+          res.abstracts[t * params.nPeople + ids[i]] = abstractID;
+      }
+    }
+  }
+  return res;
+}
+
+s32 eliteDistance(const Elite& elite1, const Elite& elite2) {
+  s32 res = 0;
+  for (size_t i = 0; i < elite1.abstracts.size(); ++i)
+    res += elite1.abstracts[i] != elite2.abstracts[i];
+  return res;
+}
+
+bool ElitePool::add(const Elite& elite) {
+  size_t closest = m_elites.size();
+  s32 closestDistance = m_minDistance;
+  for (size_t i = 0; i < m_elites.size(); ++i) {
+    s32 distance = eliteDistance(elite, m_elites[i]);
+    if (distance < closestDistance) {
+      closest = i;
+      closestDistance = distance;
+    }
+  }
+  if (closest < m_elites.size()) {
+    if (m_elites[closest].score >= elite.score)
+      return false;
+    m_elites.erase(begin(m_elites) + closest);
+  } else if (m_elites.size() >= m_capacity) {
+    if (m_elites.back().score >= elite.score)
+      return false;
+    m_elites.pop_back();
+  }
+  auto it = find_if(begin(m_elites), end(m_elites),
+                    [&](const Elite& e) { return e.score < elite.score; });
+  m_elites.insert(it, elite);
+  return true;
+}
+
+// State of a path from a schedule to a guide: the (timeslot, person) pairs
+// where the schedule differs, and the moves putting one of them right
+class PathRelinker {
+public:
+  PathRelinker(Schedule& sched, const Params& params, const Elite& guide) :
+    m_sched(sched), m_params(params), m_guide(guide),
+    m_diffPos(params.nTimeslots * params.nPeople, -1) {
+    for (s32 t = 0; t < m_params.nTimeslots; ++t)
+      updateTimeslot(t);
+  }
+
+  size_t distance() const { return m_diffs.size(); }
+  // A move putting a random differing pair as in the guide, if one can be
+  // found for it
+  bool proposeMove(Move& move);
+  void updateTimeslot(s32 timeslot);
+
+protected:
+  Schedule& m_sched;
+  const Params& m_params;
+  const Elite& m_guide;
+  std::vector<s32> m_diffs;   // timeslot * nPeople + person
+  std::vector<s32> m_diffPos; // Index in m_diffs, -1 if the same as the guide
+
+  ID guideAbstract(s32 timeslot, ID personID) const {
+    return m_guide.abstracts[timeslot * m_params.nPeople + personID];
+  }
+  // A room presenting an abstract the guide doesn't present in the timeslot
+  s32 roomToReplace(s32 timeslot) const;
+  // An abstract the guide presents in the timeslot, but the schedule not
+  ID abstractToPresent(s32 timeslot) const;
+  bool seatMove(s32 timeslot, s32 room, s32 seat, ID personID, Move& move) const;
+};
+
+void PathRelinker::updateTimeslot(s32 timeslot) {
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    s32 i = timeslot * m_params.nPeople + personID;
+    bool differs = m_sched.getPersonAbstractID(timeslot, personID) != m_guide.abstracts[i];
+    if (differs && m_diffPos[i] < 0) {
+      m_diffPos[i] = m_diffs.size();
+      m_diffs.push_back(i);
+    } else if (!differs && m_diffPos[i] >= 0) {
+      m_diffPos[m_diffs.back()] = m_diffPos[i];
+      m_diffs[m_diffPos[i]] = m_diffs.back();
+      m_diffs.pop_back();
+      m_diffPos[i] = -1;
+    }
+  }
+}
+
+s32 PathRelinker::roomToReplace(s32 timeslot) const {
+  s32 first = randInt(m_params.nRooms);
+  for (s32 i = 0; i < m_params.nRooms; ++i) {
+    s32 room = (first + i) % m_params.nRooms;
+    ID abstractID = m_sched.getAbstractID(timeslot, room);
+    if (invalidID(abstractID) || guideAbstract(timeslot, abstractID) != abstractID)
+      return room;
+  }
+  return -1;
+}
+
+ID PathRelinker::abstractToPresent(s32 timeslot) const {
+  s32 first = randInt(m_params.nRooms);
+  for (s32 i = 0; i < m_params.nRooms; ++i) {
+    s32 room = (first + i) % m_params.nRooms;
+    ID abstractID = m_guide.ids[(timeslot * m_params.nRooms + room) * m_params.roomSize];
+    if (validID(abstractID) && m_sched.getPersonAbstractID(timeslot, abstractID) != abstractID)
+      return abstractID;
+  }
+  return INVALID_ID;
+}
+
+bool PathRelinker::seatMove(s32 timeslot, s32 room, s32 seat, ID personID, Move& move) const {
+  move.timeslot = timeslot;
+  move.room1 = room;
+  move.seat1 = seat;
+  move.id1 = m_sched.getID(timeslot, room, seat);
+  if (m_sched.findPerson(timeslot, personID, move.room2, move.seat2)) {
+    move.id2 = personID;
+  } else {
+    move.room2 = move.seat2 = -1;
+    move.id2 = personID;
+  }
+  return m_sched.constraintsAllow(timeslot, room, seat, personID) &&
+         (!move.isSwap() ||
+          m_sched.constraintsAllow(timeslot, move.room2, move.seat2, move.id1));
+}
+
+bool PathRelinker::proposeMove(Move& move) {
+  s32 i = m_diffs[randInt(m_diffs.size())];
+  s32 t = i / m_params.nPeople;
+  ID personID = i % m_params.nPeople;
+  ID target = guideAbstract(t, personID);
+  ID current = m_sched.getPersonAbstractID(t, personID);
+  s32 room = -1, seat = -1;
+  if (target == personID) {
+    // Presents in the guide: in place of an abstract the guide doesn't have
+    room = roomToReplace(t);
+    return room >= 0 && seatMove(t, room, 0, personID, move);
+  }
+  if (current == personID) {
+    // Presents, but not in the guide: makes way for one the guide presents
+    ID abstractID = abstractToPresent(t);
+    return validID(abstractID) && m_sched.findPerson(t, personID, room, seat) &&
+           seatMove(t, room, 0, abstractID, move);
+  }
+  if (invalidID(target)) {
+    // Free in the guide: a free person seated in the guide takes the seat,
+    // one hearing the seat's abstract in the guide if possible
+    if (!m_sched.findPerson(t, personID, room, seat))
+      return false;
+    ID abstractID = m_sched.getAbstractID(t, room);
+    ID replacement = INVALID_ID;
+    ID first = randInt(m_params.nPeople);
+    for (ID j = 0; j < m_params.nPeople; ++j) {
+      ID other = (first + j) % m_params.nPeople;
+      ID otherTarget = guideAbstract(t, other);
+      if (!m_sched.isFreeID(t, other) || invalidID(otherTarget) || otherTarget == other)
+        continue;
+      replacement = other;
+      if (otherTarget == abstractID)
+        break;
+    }
+    return validID(replacement) && seatMove(t, room, seat, replacement, move);
+  }
+  // Hears the target in the guide: in place of a listener the guide seats
+  // elsewhere
+  if (!m_sched.findPerson(t, target, room, seat) || seat != 0)
+    return false;
+  for (seat = 1; seat < m_params.roomSize; ++seat) {
+    ID other = m_sched.getID(t, room, seat);
+    if (invalidID(other) || guideAbstract(t, other) != target)
+      return seatMove(t, room, seat, personID, move);
+  }
+  return false;
+}
+
+void relinkPath(Schedule& sched, const Params& params, Scorer& scorer, const Elite& guide,
+                s32 nCandidates) {
+  PathRelinker path(sched, params, guide);
+  const size_t startDistance = path.distance();
+  vector<ID> startIDs, bestIDs;
+  sched.getAllIDs(startIDs);
+  Score bestScore = -numeric_limits<Score>::infinity();
+  while (path.distance() > 0) {
+    Move best;
+    Score bestMoveScore = -numeric_limits<Score>::infinity();
+    // Most pairs only get right along with others, give up if nearly no
+    // move can be made
+    for (s32 i = 0, nEvaluated = 0; i < nCandidates * 20 && nEvaluated < nCandidates; ++i) {
+      Move move;
+      if (!path.proposeMove(move) || !applyMove(sched, scorer, move))
+        continue;
+      ++nEvaluated;
+      if (scorer.score() > bestMoveScore) {
+        best = move;
+        bestMoveScore = scorer.score();
+      }
+      undoMove(sched, scorer, move);
+    }
+    if (bestMoveScore == -numeric_limits<Score>::infinity())
+      break;
+    applyMove(sched, scorer, best);
+    path.updateTimeslot(best.timeslot);
+    if (path.distance() > 0 && path.distance() < startDistance &&
+        scorer.score() > bestScore) {
+      sched.getAllIDs(bestIDs);
+      bestScore = scorer.score();
+    }
+  }
+  dbg() << "Relinked path of " << startDistance << " pairs, stopped at " << path.distance()
+        << ", best: " << bestScore << endl;
+  sched.setAllIDs(bestIDs.empty() ? startIDs : bestIDs);
+  scorer.recalcScore();
+}
+
+static string inDir(const string& dir, const string& name) {
+  return (boost::filesystem::path(dir) / name).string();
+}
+
+static bool saveElites(const Schedule& sched, const Params& params, const ElitePool& pool) {
+  if (params.resultsDir.empty())
+    return true;
+  const Elite& best = pool.elites().front();
+  string schedPath = inDir(params.resultsDir, "best_schedule.csv");
+  ofstream schedFile(schedPath);
+  sched.outputIDs(schedFile, best.ids);
+  string itinerariesPath = inDir(params.resultsDir, "best_itineraries.csv");
+  ofstream itinerariesFile(itinerariesPath);
+  sched.outputItineraries(itinerariesFile);
+  string metadataPath = inDir(params.resultsDir, "best_schedule.metadata");
+  ofstream metadataFile(metadataPath);
+  metadataFile << "Score: " << best.score << endl;
+  metadataFile << "Run: " << (best.run + 1) << endl;
+  outputParams(params, metadataFile);
+  sched.stats().output(metadataFile);
+  string poolPath = inDir(params.resultsDir, "elite_pool.csv");
+  ofstream poolFile(poolPath);
+  poolFile << "rank,run,score,distance_to_best" << endl;
+  for (size_t i = 0; i < pool.size(); ++i) {
+    const Elite& elite = pool.elites()[i];
+    poolFile << (i + 1) << "," << (elite.run + 1) << "," << elite.score << ","
+             << eliteDistance(elite, best) << endl;
+  }
+  return checkWritten(schedFile, schedPath) && checkWritten(itinerariesFile, itinerariesPath) &&
+         checkWritten(metadataFile, metadataPath) && checkWritten(poolFile, poolPath);
+}
+
+bool runRestarts(Schedule& sched, const Params& params) {
+  if (params.restarts <= 0)
+    return runPhases(sched, params);
+  // Schedules differing in under 1% of the pairs count as the same
+  ElitePool pool(max(1, params.eliteSize), max(1, params.nTimeslots * params.nPeople / 100));
+  vector<ID> ids;
+  for (s32 run = 0; run <= params.restarts; ++run) {
+    if (params.cancel && params.cancel->load())
+      break;
+    Params runParams = params;
+    if (!params.resultsDir.empty()) {
+      runParams.resultsDir = inDir(params.resultsDir, "run_" + to_string(run + 1));
+      boost::filesystem::create_directories(runParams.resultsDir);
+    }
+    unique_ptr<Scorer> scorer = createScorer(sched, params, params.phases.back());
+    if (run > 0 && pool.size() >= 2) {
+      s32 from = randInt(pool.size()), to = randInt(pool.size() - 1);
+      to += (to >= from);
+      sched.setAllIDs(pool.elites()[from].ids);
+      scorer->recalcScore();
+      relinkPath(sched, params, *scorer, pool.elites()[to], params.relinkCandidates);
+      // Annealing hot would lose what the path combined
+      runParams.initTempFactor = params.relinkTemp;
+      info() << "Run " << (run + 1) << " starts on the path from elite " << (from + 1)
+             << " to elite " << (to + 1) << ", score: " << scorer->score() << endl;
+    } else if (run > 0) {
+      sched.reset();
+      sched.initState();
+      info() << "Run " << (run + 1) << " starts from a new initial schedule" << endl;
+    }
+    if (!runPhases(sched, runParams))
+      return false;
+    scorer->recalcScore();
+    sched.getAllIDs(ids);
+    bool added = pool.add(makeElite(params, ids, scorer->score(), run));
+    info() << "Run " << (run + 1) << " score: " << scorer->score()
+           << (added ? ", added to the elite pool" : "") << endl;
+  }
+  if (pool.size() == 0)
+    return true;
+  sched.setAllIDs(pool.elites().front().ids);
+  info() << "Best of " << pool.size() << " elites: " << pool.elites().front().score
+         << " (run " << (pool.elites().front().run + 1) << ")" << endl;
+  return saveElites(sched, params, pool);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "params.hh"
+#include "schedule.hh"
+#include "scorer.hh"
+
+#include <vector>
+
+
+// A schedule of the elite pool. Rooms are interchangeable within a
+// timeslot, so schedules are compared by the abstract each person hears (or
+// presents) in each timeslot rather than by their room.
+struct Elite {
+  std::vector<ID> ids;
+  std::vector<ID> abstracts; // [timeslot * nPeople + person], INVALID_ID if free
+  Score score;
+  s32 run;                   // From 0
+};
+
+Elite makeElite(const Params& params, const std::vector<ID>& ids, Score score, s32 run);
+// Number of (timeslot, person) pairs with a different abstract
+s32 eliteDistance(const Elite& elite1, const Elite& elite2);
+
+// The best schedules found, kept at least minDistance apart. A schedule
+// within minDistance of an elite only replaces it if it's better; otherwise
+// it joins the pool, replacing the worst elite once the pool is full.
+class ElitePool {
+public:
+  ElitePool(size_t capacity, s32 minDistance) :
+    m_capacity(capacity), m_minDistance(minDistance) {}
+
+  // True if the schedule entered the pool
+  bool add(const Elite& elite);
+  // Best first
+  const std::vector<Elite>& elites() const { return m_elites; }
+  size_t size() const { return m_elites.size(); }
+
+protected:
+  const size_t m_capacity;
+  const s32 m_minDistance;
+  std::vector<Elite> m_elites;
+};
+
+// Walks from the schedule towards the guide through legal moves, each step
+// taking the best scoring of up to nCandidates moves seating someone as in
+// the guide, and leaves the best schedule strictly between the two. Leaves
+// the schedule unchanged if the walk reaches no such schedule.
+void relinkPath(Schedule& sched, const Params& params, Scorer& scorer, const Elite& guide,
+                s32 nCandidates);
+
+// Runs the phases 1 + params.restarts times, keeping an elite pool of the
+// params.eliteSize best diverse schedules. Once the pool has two elites,
+// each restart starts from the path relinking of two random ones, with the
+// phases' initial temperature (calibrated or not) scaled by
+// params.relinkTemp. Every run
+// saves its results to its own run_N directory, and the best elite and the
+// pool are saved to the results directory. Without restarts, only runs the
+// phases.
+bool runRestarts(Schedule& sched, const Params& params);
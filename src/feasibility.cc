@@ -0,0 +1,228 @@
+#include "feasibility.hh"
+#include "flow.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+
+bool FeasibilityReport::feasible() const {
+  for (const FeasibilityCheck& check : checks) {
+    if (!check.ok())
+      return false;
+  }
+  return true;
+}
+
+const FeasibilityCheck& FeasibilityReport::binding() const {
+  const FeasibilityCheck* res = &checks.front();
+  double minSlack = 1;
+  for (const FeasibilityCheck& check : checks) {
+    if (!check.ok())
+      return check;
+    if (!check.hasSlack)
+      continue;
+    double slack = double(check.available - check.needed) / max(s64(1), check.available);
+    if (slack < minSlack) {
+      minSlack = slack;
+      res = &check;
+    }
+  }
+  return *res;
+}
+
+// Most presentations an abstract can get: its presenter must still hear
+// minParticipations abstracts, and hears none while presenting. Every
+// presentation needs distinct listeners.
+static s32 maxAbstractPresentations(const Params& params) {
+  s32 ownerFree = params.nTimeslots - s32(params.minParticipations);
+  s32 distinctListeners = (params.nPeople - 1) / max(1, params.roomSize - 1);
+  return max(0, min(min(s32(params.maxPresentations), ownerFree), distinctListeners));
+}
+
+// Most abstracts a person can hear
+static s32 maxPersonListens(const Params& params, ID personID) {
+  bool presenter = personID < params.nAbstracts;
+  return min(s32(params.maxParticipations),
+             min(params.nTimeslots, params.nAbstracts) - (presenter ? 1 : 0));
+}
+
+// Flow network with lower bounds on the edges, reduced to a max flow from a
+// super source to a super sink which is feasible iff it saturates them
+class BoundedFlow final {
+public:
+  explicit BoundedFlow(s32 nNodes) :
+    m_flow(nNodes + 2), m_excess(nNodes + 2, 0), m_superSource(nNodes), m_superSink(nNodes + 1) {}
+
+  void addEdge(s32 from, s32 to, s32 minFlow, s32 capacity) {
+    if (capacity > minFlow)
+      m_flow.addEdge(from, to, capacity - minFlow);
+    m_excess[to] += minFlow;
+    m_excess[from] -= minFlow;
+  }
+
+  // Units of the lower bounds no flow can meet
+  s64 shortfall() {
+    s64 required = 0;
+    for (s32 node = 0; node < m_superSource; ++node) {
+      if (m_excess[node] > 0) {
+        m_flow.addEdge(m_superSource, node, m_excess[node]);
+        required += m_excess[node];
+      } else if (m_excess[node] < 0) {
+        m_flow.addEdge(node, m_superSink, -m_excess[node]);
+      }
+    }
+    return required - m_flow.solve(m_superSource, m_superSink);
+  }
+
+protected:
+  MaxFlow m_flow;
+  std::vector<s64> m_excess;
+  const s32 m_superSource, m_superSink;
+};
+
+static FeasibilityCheck checkListenerFlow(const Params& params) {
+  // source -> person -> abstract -> sink, with exactly nSeats units through
+  // sink -> source
+  const s32 nSeats = params.nTimeslots * params.nRooms * (params.roomSize - 1);
+  const s32 source = 0, firstPerson = 1;
+  const s32 firstAbstract = firstPerson + params.nPeople;
+  const s32 sink = firstAbstract + params.nAbstracts;
+  BoundedFlow flow(sink + 1);
+  for (ID personID = 0; personID < params.nPeople; ++personID) {
+    s32 maxListens = max(0, maxPersonListens(params, personID));
+    flow.addEdge(source, firstPerson + personID,
+                 min(s32(params.minParticipations), maxListens), maxListens);
+    for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+      if (abstractID != personID)
+        flow.addEdge(firstPerson + personID, firstAbstract + abstractID, 0, 1);
+    }
+  }
+  const s32 listenersPerRoom = params.roomSize - 1;
+  const s32 maxPresentations = max(1, maxAbstractPresentations(params));
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID)
+    flow.addEdge(firstAbstract + abstractID, sink, listenersPerRoom,
+                 maxPresentations * listenersPerRoom);
+  flow.addEdge(sink, source, nSeats, nSeats);
+  return FeasibilityCheck{"listener_flow",
+    "seats filled meeting every person's and abstract's minimum listens",
+    nSeats, nSeats - flow.shortfall(), false};
+}
+
+// The counting checks, O(1) each
+static FeasibilityReport countingChecks(const Params& params) {
+  FeasibilityReport report;
+  const s64 nRooms = s64(params.nTimeslots) * params.nRooms;
+  const s64 nSeats = nRooms * (params.roomSize - 1);
+  report.checks.push_back(FeasibilityCheck{"abstracts",
+    "every abstract presented at least once (rooms over all timeslots)",
+    params.nAbstracts, nRooms, true});
+  report.checks.push_back(FeasibilityCheck{"presentations",
+    "rooms over all timeslots, filled by presentations of at most "
+    "min(max_presentations, timeslots - min participations, distinct listeners) per abstract",
+    nRooms, s64(params.nAbstracts) * maxAbstractPresentations(params), true});
+  report.checks.push_back(FeasibilityCheck{"timeslot_seats",
+    "seats of one timeslot, one per person", s64(params.nRooms) * params.roomSize,
+    params.nPeople, true});
+  // Presenters (the first nAbstracts people) hear one less
+  const s32 nPresenters = min(params.nPeople, params.nAbstracts);
+  s64 maxListens = s64(nPresenters) * max(0, maxPersonListens(params, 0)) +
+    s64(params.nPeople - nPresenters) * max(0, maxPersonListens(params, params.nAbstracts));
+  report.checks.push_back(FeasibilityCheck{"min_participations",
+    "seats for every person's min participations", s64(params.nPeople) * params.minParticipations,
+    nSeats, true});
+  report.checks.push_back(FeasibilityCheck{"max_participations",
+    "seats filled by people's max participations (one less for presenters)", nSeats,
+    maxListens, true});
+  return report;
+}
+
+FeasibilityReport analyzeFeasibility(const Params& params) {
+  FeasibilityReport report = countingChecks(params);
+  if (report.feasible())
+    report.checks.push_back(checkListenerFlow(params));
+  return report;
+}
+
+void outputFeasibility(const FeasibilityReport& report, ostream& s) {
+  for (const FeasibilityCheck& check : report.checks) {
+    s << (check.ok() ? "OK   " : "FAIL ") << check.name << ": needs " << check.needed
+      << ", available " << check.available << " (" << check.description << ")" << endl;
+  }
+  s << (report.feasible() ? "Feasible, tightest: " : "Infeasible, binding: ")
+    << report.binding().name << endl;
+}
+
+// Flow checks tried per setting: the counting checks filter the values
+// first, and values passing them rarely fail the flow
+static const s32 MAX_FLOW_CHECKS = 16;
+
+// Whether the changed params are feasible. Only counts the flow check
+// against flowChecks, run once the counting checks pass.
+static bool feasibleWith(const Params& params, const function<void(Params&)>& change,
+                         s32& flowChecks) {
+  Params cur = params;
+  change(cur);
+  if (cur.nTimeslots < 1 || cur.nRooms < 1 || cur.roomSize < 2)
+    return false;
+  calcParticipationBounds(cur);
+  if (!countingChecks(cur).feasible() || flowChecks >= MAX_FLOW_CHECKS)
+    return false;
+  ++flowChecks;
+  return checkListenerFlow(cur).ok();
+}
+
+vector<string> suggestFeasibleParams(const Params& params) {
+  vector<string> res;
+  auto smallest = [&](const string& name, s32 minValue, s32 maxValue,
+                      const function<void(Params&, s32)>& set) {
+    s32 flowChecks = 0;
+    for (s32 v = minValue; v <= maxValue && flowChecks < MAX_FLOW_CHECKS; ++v) {
+      if (feasibleWith(params, [&](Params& p) { set(p, v); }, flowChecks)) {
+        res.push_back(name + "=" + to_string(v));
+        return;
+      }
+    }
+  };
+  // Ties go to the smaller value
+  auto closest = [&](const string& name, s32 cur, s32 maxValue,
+                     const function<void(Params&, s32)>& set) {
+    s32 flowChecks = 0;
+    for (s32 d = 0; d <= max(cur, maxValue - cur) && flowChecks < MAX_FLOW_CHECKS; ++d) {
+      for (s32 v : {cur - d, cur + d}) {
+        if (v >= 1 && v <= maxValue &&
+            feasibleWith(params, [&](Params& p) { set(p, v); }, flowChecks)) {
+          res.push_back(name + "=" + to_string(v));
+          return;
+        }
+      }
+    }
+  };
+  smallest("participation_range", 0, params.nTimeslots,
+           [](Params& p, s32 v) { p.participationRange = v; });
+  smallest("max_presentations", 1, params.nTimeslots,
+           [](Params& p, s32 v) { p.maxPresentations = v; });
+  closest("timeslots", params.nTimeslots, 4 * params.nTimeslots,
+          [](Params& p, s32 v) { p.nTimeslots = v; });
+  closest("rooms", params.nRooms, params.nPeople, [](Params& p, s32 v) { p.nRooms = v; });
+  closest("room_size", params.roomSize, params.nPeople, [](Params& p, s32 v) { p.roomSize = v; });
+  return res;
+}
+
+bool checkFeasibility(const Params& params) {
+  FeasibilityReport report = analyzeFeasibility(params);
+  if (report.feasible()) {
+    dbg() << "Feasibility:" << endl;
+    outputFeasibility(report, dbg());
+    return true;
+  }
+  outputFeasibility(report, err() << "Settings can't be met:" << endl);
+  vector<string> suggestions = suggestFeasibleParams(params);
+  auto& log = info() << "Nearest feasible settings, each changed on its own:";
+  for (const string& suggestion : suggestions)
+    log << " " << suggestion;
+  log << endl;
+  return false;
+}
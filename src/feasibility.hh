@@ -0,0 +1,48 @@
+#pragma once
+
+#include "defs.hh"
+#include "params.hh"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Necessary conditions of a feasible schedule, checked before optimizing.
+// Each compares what the event needs with what the settings allow, so the
+// slack shows how close to infeasible the settings are.
+struct FeasibilityCheck {
+  std::string name;
+  std::string description;
+  s64 needed, available;
+  bool hasSlack; // False for pass or fail checks, where available <= needed
+
+  bool ok() const { return needed <= available; }
+};
+
+struct FeasibilityReport {
+  std::vector<FeasibilityCheck> checks;
+
+  bool feasible() const;
+  // The first failed check, or the one with the least relative slack
+  const FeasibilityCheck& binding() const;
+};
+
+// Counting checks, then a flow check of the listeners only if they pass.
+// The flow is a relaxation of the schedule without timeslots: people hear
+// distinct abstracts which aren't their own, between minParticipations and
+// maxParticipations of them (one less for presenters), and every abstract
+// has the listeners of 1 to maxPresentations rooms, all seats filled.
+FeasibilityReport analyzeFeasibility(const Params& params);
+
+// Nearest feasible values of the event settings, each changed on its own:
+// the smallest participation range and max presentations, and the closest
+// number of timeslots, rooms and room size. Only values passing the
+// counting checks get a flow check, at most 16 per setting. Settings with
+// no feasible value found are left out.
+std::vector<std::string> suggestFeasibleParams(const Params& params);
+
+void outputFeasibility(const FeasibilityReport& report, std::ostream& s);
+
+// Logs the report if infeasible, with suggestions. Returns feasibility.
+bool checkFeasibility(const Params& params);
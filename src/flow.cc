@@ -0,0 +1,174 @@
+#include "flow.hh"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace {
+const double INF_COST = numeric_limits<double>::infinity();
+const double COST_EPSILON = 1e-9;
+}
+
+s32 MinCostFlow::addEdge(s32 from, s32 to, s32 capacity, double cost) {
+  s32 idx = m_edges.size();
+  m_edges.push_back(Edge{to, capacity, 0, cost});
+  m_adj[from].push_back(idx);
+  m_edges.push_back(Edge{from, 0, 0, -cost});
+  m_adj[to].push_back(idx + 1);
+  return idx;
+}
+
+bool MinCostFlow::calcPotentials(s32 source) {
+  // Bellman-Ford (queue based), edges may have negative costs
+  s32 n = nNodes();
+  m_potential.assign(n, INF_COST);
+  vector<bool> inQueue(n, false);
+  vector<s32> nRelaxed(n, 0);
+  deque<s32> queue;
+  m_potential[source] = 0;
+  queue.push_back(source);
+  inQueue[source] = true;
+  while (!queue.empty()) {
+    s32 u = queue.front();
+    queue.pop_front();
+    inQueue[u] = false;
+    for (s32 e : m_adj[u]) {
+      const Edge& edge = m_edges[e];
+      if (edge.capacity - edge.flow <= 0)
+        continue;
+      double d = m_potential[u] + edge.cost;
+      if (d < m_potential[edge.to] - COST_EPSILON) {
+        m_potential[edge.to] = d;
+        if (!inQueue[edge.to]) {
+          if (++nRelaxed[edge.to] > n)
+            return false; // Negative cycle
+          queue.push_back(edge.to);
+          inQueue[edge.to] = true;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool MinCostFlow::shortestPath(s32 source, s32 sink, vector<s32>& prevEdge, vector<double>& dist) {
+  // Dijkstra on reduced costs
+  s32 n = nNodes();
+  dist.assign(n, INF_COST);
+  prevEdge.assign(n, -1);
+  using Item = pair<double, s32>;
+  priority_queue<Item, vector<Item>, greater<Item>> heap;
+  dist[source] = 0;
+  heap.push(Item(0, source));
+  while (!heap.empty()) {
+    Item item = heap.top();
+    heap.pop();
+    s32 u = item.second;
+    if (item.first > dist[u])
+      continue;
+    for (s32 e : m_adj[u]) {
+      const Edge& edge = m_edges[e];
+      if (edge.capacity - edge.flow <= 0 || m_potential[edge.to] == INF_COST)
+        continue;
+      double reduced = max(0.0, edge.cost + m_potential[u] - m_potential[edge.to]);
+      double d = dist[u] + reduced;
+      if (d < dist[edge.to] - COST_EPSILON) {
+        dist[edge.to] = d;
+        prevEdge[edge.to] = e;
+        heap.push(Item(d, edge.to));
+      }
+    }
+  }
+  // Nodes not reached now stay unreachable, since augmenting only adds
+  // residual edges between nodes of the augmenting path
+  for (s32 v = 0; v < n; ++v) {
+    m_potential[v] = (dist[v] == INF_COST) ? INF_COST : m_potential[v] + dist[v];
+  }
+  return dist[sink] != INF_COST;
+}
+
+double MinCostFlow::solve(s32 source, s32 sink, s32 maxFlow, bool onlyImproving, s32& totalFlow) {
+  totalFlow = 0;
+  double totalCost = 0;
+  if (!calcPotentials(source))
+    return 0;
+  vector<s32> prevEdge;
+  vector<double> dist;
+  while (totalFlow < maxFlow && shortestPath(source, sink, prevEdge, dist)) {
+    double pathCost = m_potential[sink] - m_potential[source];
+    if (onlyImproving && pathCost >= -COST_EPSILON)
+      break;
+    s32 pushed = maxFlow - totalFlow;
+    for (s32 v = sink; v != source; v = m_edges[prevEdge[v] ^ 1].to) {
+      const Edge& edge = m_edges[prevEdge[v]];
+      pushed = min(pushed, edge.capacity - edge.flow);
+    }
+    for (s32 v = sink; v != source; v = m_edges[prevEdge[v] ^ 1].to) {
+      m_edges[prevEdge[v]].flow += pushed;
+      m_edges[prevEdge[v] ^ 1].flow -= pushed;
+    }
+    totalFlow += pushed;
+    totalCost += pushed * pathCost;
+  }
+  return totalCost;
+}
+
+s32 MaxFlow::addEdge(s32 from, s32 to, s32 capacity) {
+  s32 idx = m_edges.size();
+  m_edges.push_back(Edge{to, capacity, 0});
+  m_adj[from].push_back(idx);
+  m_edges.push_back(Edge{from, 0, 0});
+  m_adj[to].push_back(idx + 1);
+  return idx;
+}
+
+bool MaxFlow::calcLevels(s32 source, s32 sink) {
+  m_level.assign(nNodes(), -1);
+  m_level[source] = 0;
+  queue<s32> q;
+  q.push(source);
+  while (!q.empty()) {
+    s32 node = q.front();
+    q.pop();
+    for (s32 e : m_adj[node]) {
+      const Edge& edge = m_edges[e];
+      if (edge.flow < edge.capacity && m_level[edge.to] < 0) {
+        m_level[edge.to] = m_level[node] + 1;
+        q.push(edge.to);
+      }
+    }
+  }
+  return m_level[sink] >= 0;
+}
+
+s32 MaxFlow::augment(s32 node, s32 sink, s32 limit) {
+  if (node == sink)
+    return limit;
+  for (size_t& i = m_nextEdge[node]; i < m_adj[node].size(); ++i) {
+    s32 e = m_adj[node][i];
+    Edge& edge = m_edges[e];
+    if (edge.flow >= edge.capacity || m_level[edge.to] != m_level[node] + 1)
+      continue;
+    s32 pushed = augment(edge.to, sink, min(limit, edge.capacity - edge.flow));
+    if (pushed > 0) {
+      edge.flow += pushed;
+      m_edges[e ^ 1].flow -= pushed;
+      return pushed;
+    }
+  }
+  return 0;
+}
+
+s32 MaxFlow::solve(s32 source, s32 sink) {
+  s32 total = 0;
+  while (calcLevels(source, sink)) {
+    m_nextEdge.assign(nNodes(), 0);
+    while (s32 pushed = augment(source, sink, numeric_limits<s32>::max()))
+      total += pushed;
+  }
+  return total;
+}
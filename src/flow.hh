@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defs.hh"
+#include <vector>
+
+
+// Min cost flow solver (successive shortest paths with node potentials).
+// Used for exact re-assignment of listeners to rooms.
+class MinCostFlow final {
+public:
+  explicit MinCostFlow(s32 nNodes) : m_adj(nNodes) {}
+
+  // Returns the edge index, which can later be passed to flow()
+  s32 addEdge(s32 from, s32 to, s32 capacity, double cost);
+
+  // Sends up to maxFlow units from source to sink. If onlyImproving is set,
+  // stops as soon as the cheapest augmenting path has non-negative cost, i.e.
+  // finds the min cost flow of any size. Returns the total cost.
+  double solve(s32 source, s32 sink, s32 maxFlow, bool onlyImproving, s32& totalFlow);
+
+  s32 flow(s32 edge) const { return m_edges[edge].flow; }
+  s32 nNodes() const { return m_adj.size(); }
+
+protected:
+  struct Edge {
+    s32 to;
+    s32 capacity;
+    s32 flow;
+    double cost;
+  };
+
+  std::vector<Edge> m_edges; // Edge i^1 is the reverse of edge i
+  std::vector<std::vector<s32>> m_adj;
+  std::vector<double> m_potential;
+
+  bool calcPotentials(s32 source);
+  bool shortestPath(s32 source, s32 sink, std::vector<s32>& prevEdge, std::vector<double>& dist);
+};
+
+// Max flow solver (Dinic's algorithm), for feasibility checks on graphs too
+// big for the min cost flow
+class MaxFlow final {
+public:
+  explicit MaxFlow(s32 nNodes) : m_adj(nNodes) {}
+
+  // Returns the edge index, which can later be passed to flow()
+  s32 addEdge(s32 from, s32 to, s32 capacity);
+
+  // Sends as many units as possible from source to sink. Returns the total.
+  s32 solve(s32 source, s32 sink);
+
+  s32 flow(s32 edge) const { return m_edges[edge].flow; }
+  s32 nNodes() const { return m_adj.size(); }
+
+protected:
+  struct Edge {
+    s32 to;
+    s32 capacity;
+    s32 flow;
+  };
+
+  std::vector<Edge> m_edges; // Edge i^1 is the reverse of edge i
+  std::vector<std::vector<s32>> m_adj;
+  std::vector<s32> m_level;
+  std::vector<std::size_t> m_nextEdge;
+
+  bool calcLevels(s32 source, s32 sink);
+  s32 augment(s32 node, s32 sink, s32 limit);
+};
@@ -0,0 +1,113 @@
+#include "lns.hh"
+
+#include <iomanip>
+
+using namespace std;
+
+
+bool LargeNeighbourhoodSearch::run() {
+  m_startTime = chrono::system_clock::now();
+  m_bestScore = m_scorer.score();
+  handleNewBest();
+  s32 blockRooms = m_params.lnsBlockRooms;
+  bool wholeTimeslots = (blockRooms <= 0 || blockRooms >= m_params.nRooms);
+  if (wholeTimeslots)
+    blockRooms = m_params.nRooms;
+  double nextOutputSec = 0;
+  u64 lastImprovedIter = 0;
+  for (m_iter = 0; m_iter < m_params.lnsRounds; ++m_iter) {
+    // Whole timeslots are visited round robin, so a full round without an
+    // improvement means no single timeslot repair can improve the schedule
+    if (wholeTimeslots && m_iter - lastImprovedIter > u64(m_params.nTimeslots)) {
+      dbg() << "LNS reached a local optimum" << endl;
+      break;
+    }
+    s32 t = wholeTimeslots ? (m_iter % m_params.nTimeslots) : randInt(m_params.nTimeslots);
+    s32 firstRoom = wholeTimeslots ? 0 : randInt(m_params.nRooms);
+    try {
+      if (repairRooms(t, firstRoom, blockRooms)) {
+        ++m_nImproved;
+        lastImprovedIter = m_iter;
+      }
+      if (m_scorer.score() > m_bestScore) {
+        if (!handleNewBest())
+          return false;
+        m_bestScore = m_scorer.score();
+      }
+    } catch(std::exception& e) {
+      err() << "Error in LNS round " << m_iter << ": " << e.what() << endl;
+      return false;
+    }
+    if (elapsedSecs(m_startTime) >= nextOutputSec) {
+      if (!outputStatus(dbg()))
+        return false;
+      nextOutputSec += m_params.progressSeconds;
+    }
+    if (reachedStopCondition())
+      break;
+  }
+  // Repairs within the tolerance of the score are kept too, so the schedule
+  // can have drifted below the best one
+  restoreBest();
+  return outputStatus(info());
+}
+
+bool LargeNeighbourhoodSearch::repairRooms(s32 timeslot, s32 firstRoom, s32 nRooms) {
+  Score prevScore = m_scorer.score();
+
+  vector<s32> rooms;
+  for (s32 i = 0; i < nRooms; ++i)
+    rooms.push_back((firstRoom + i) % m_params.nRooms);
+
+  // Take all listeners out of the rooms
+  vector<ID> prevIDs;
+  vector<bool> removed(m_params.nPeople, false);
+  for (s32 r : rooms) {
+    for (s32 s = 1; s < m_params.roomSize; ++s) {
+      ID personID = m_sched.getID(timeslot, r, s);
+      prevIDs.push_back(personID);
+      if (validID(personID))
+        removed[personID] = true;
+      m_sched.setIDUnsafe(timeslot, r, s, INVALID_ID);
+    }
+  }
+  auto restore = [&]() {
+    for (s32 r : rooms) {
+      for (s32 s = 1; s < m_params.roomSize; ++s)
+        m_sched.setIDUnsafe(timeslot, r, s, INVALID_ID);
+    }
+    size_t i = 0;
+    for (s32 r : rooms) {
+      for (s32 s = 1; s < m_params.roomSize; ++s)
+        m_sched.setIDUnsafe(timeslot, r, s, prevIDs[i++]);
+    }
+  };
+
+  // People taken out who would drop below minParticipations must be seated
+  vector<bool> mustAttend(m_params.nPeople, false);
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    mustAttend[personID] = removed[personID] &&
+      m_sched.getPersonCount(personID) < static_cast<s32>(m_params.minParticipations);
+  }
+  if (!m_sched.assignListeners(timeslot, rooms, mustAttend)) {
+    restore();
+    return false;
+  }
+
+  m_scorer.recalcScore();
+  Score tolerance = m_params.minNormScore / 1000;
+  if (m_scorer.score() < prevScore - tolerance) {
+    restore();
+    m_scorer.recalcScore();
+    return false;
+  }
+  return m_scorer.score() > prevScore + tolerance;
+}
+
+bool LargeNeighbourhoodSearch::outputStatus(ostream& s) {
+  s << "LNS round " << double(m_iter) << "/" << double(m_params.lnsRounds)
+    << " improving repairs: " << m_nImproved << setprecision(4)
+    << " score: " << m_scorer.score() << " best so far:" << m_bestScore << endl;
+  reportProgress();
+  return saveBest();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "optimizer.hh"
+
+
+// Large neighbourhood search: keeps the presenters of a timeslot (or of a
+// block of its rooms) fixed and re-solves the listener assignment of those
+// rooms exactly as a min cost flow problem.
+class LargeNeighbourhoodSearch final : public Optimizer {
+public:
+  LargeNeighbourhoodSearch(Schedule& sched, const Options& params, Scorer& scorer) :
+    Optimizer(sched, params, scorer) {}
+
+  virtual bool run() override;
+
+  // Re-assigns the listeners of nRooms rooms starting at firstRoom (wrapping
+  // around). Keeps the change only if the scorer's score doesn't decrease.
+  bool repairRooms(s32 timeslot, s32 firstRoom, s32 nRooms);
+
+protected:
+  u64 m_nImproved = 0;
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Improving repairs: " << m_nImproved << std::endl;
+  }
+
+  bool outputStatus(std::ostream& s);
+};
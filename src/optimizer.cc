@@ -0,0 +1,299 @@
+#include "optimizer.hh"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+
+void Optimizer::outputSchedSummary(ostream& s) {
+  s << endl;
+  for (s32 t = 0; t < m_params.nTimeslots; ++t) {
+    Score tScore = 0;
+    s << setw(2) << (t + 1) << " || ";
+    for (s32 r = 0; r < m_params.nRooms; ++r) {
+      Score rScore = m_scorer.calcRoomScore(t, r);
+      s << setw(3) << m_sched.getAbstractID(t, r) << " " << setw(4) << rScore << " | ";
+      tScore += rScore;
+    }
+    s << tScore << endl;
+  }
+}
+
+void Optimizer::outputSchedStats(ostream& s, const Schedule& sched) {
+  sched.stats().output(s);
+}
+
+string Optimizer::inResultsDir(string name) {
+  return (boost::filesystem::path(m_params.resultsDir) / name).c_str();
+}
+
+bool Optimizer::reachedStopCondition() {
+  if (m_params.targetGap > 0 && gap() <= m_params.targetGap) {
+    info() << "Reached target gap: " << gap() << endl;
+    return true;
+  }
+  if (m_params.stallIterations > 0 && m_iter - m_bestIter >= m_params.stallIterations) {
+    info() << "No improvement since iter " << m_bestIter << endl;
+    return true;
+  }
+  if (m_params.maxSeconds > 0 && elapsedSecs(m_startTime) >= m_params.maxSeconds) {
+    info() << "Reached time limit" << endl;
+    return true;
+  }
+  if (m_params.cancel && m_params.cancel->load(memory_order_relaxed)) {
+    info() << "Cancelled at iter " << m_iter << endl;
+    return true;
+  }
+  return false;
+}
+
+void Optimizer::reportProgress() {
+  if (!m_params.onProgress)
+    return;
+  const Schedule& best = m_bestSchedule.empty() ? m_sched : bestSchedule();
+  double progressGap = usesGap() ? gap() : numeric_limits<double>::quiet_NaN();
+  m_params.onProgress(Progress{0, m_iter, m_scorer.score(), m_bestScore, progressGap,
+                               elapsedSecs(m_startTime), &best});
+}
+
+bool Optimizer::saveBest() {
+  PROFILE_SCOPE(SaveBest);
+  // Embedding programs may keep the results in memory only
+  if (m_bestSchedule.empty() || m_params.resultsDir.empty())
+    return true;
+  string schedPath = inResultsDir("best_schedule.csv");
+  ofstream schedFile(schedPath);
+  if (schedFile.bad() || schedFile.fail()) {
+    err() << "Error opening file '" << schedPath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  m_sched.outputIDs(schedFile, m_bestSchedule);
+
+  string itinerariesPath = inResultsDir("best_itineraries.csv");
+  ofstream itinerariesFile(itinerariesPath);
+  if (itinerariesFile.bad() || itinerariesFile.fail()) {
+    err() << "Error opening file '" << itinerariesPath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  bestSchedule().outputItineraries(itinerariesFile);
+
+  string metadataPath = inResultsDir("best_schedule.metadata");
+  ofstream metadataFile(metadataPath);
+  if (metadataFile.bad() || metadataFile.fail()) {
+    err() << "Error opening file '" << metadataPath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  metadataFile << "Score: " << m_scorer.score() << endl;
+  metadataFile << "Iter: " << m_iter << endl;
+  if (usesGap()) {
+    metadataFile << "Upper bound: " << upperBound() << endl;
+    metadataFile << "Gap: " << gap() << endl;
+  }
+  outputMetadata(metadataFile);
+  metadataFile << "Elapsed seconds: " << elapsedSecs(m_startTime) << endl;
+  outputOptions(m_params, metadataFile);
+  outputSchedSummary(metadataFile);
+  outputSchedStats(metadataFile, bestSchedule());
+  return true;
+}
+
+vector<Score> Optimizer::sampleScoreDeltas(s32 maxSamples) {
+  vector<Score> deltas;
+  const Score curScore = m_scorer.score();
+  // Most proposals are illegal, give up if nearly all of them are
+  for (s64 i = 0; i < s64(maxSamples) * 100 && s32(deltas.size()) < maxSamples; ++i) {
+    Move move;
+    if (!proposeMove(move) || !applyMove(move))
+      continue;
+    deltas.push_back(m_scorer.score() - curScore);
+    undoMove(move);
+  }
+  return deltas;
+}
+
+bool Optimizer::proposeMove(Move& move) {
+  bool proposed;
+  if (m_params.worstOffMoves > 0 && hasWorstOff() && randProb() < m_params.worstOffMoves)
+    proposed = proposeWorstOffMove(move);
+  else if (m_params.guidedMoves > 0 && randProb() < m_params.guidedMoves)
+    proposed = proposeGuidedMove(move);
+  else
+    proposed = proposeUniformMove(move);
+  // Moves breaking the constraints file never get evaluated
+  return proposed && (!m_params.instance->hasConstraints || constraintsAllow(move));
+}
+
+bool Optimizer::constraintsAllow(const Move& move) {
+  return m_sched.constraintsAllow(move.timeslot, move.room1, move.seat1, move.id2) &&
+         (!move.isSwap() ||
+          m_sched.constraintsAllow(move.timeslot, move.room2, move.seat2, move.id1));
+}
+
+bool Optimizer::proposeUniformMove(Move& move) {
+  s32 t = randTimeslot();
+  s32 i1 = randInt(m_params.nPeople), i2 = randInt(m_params.nPeople);
+  if (i2 < i1)
+    swap(i1, i2);
+  if (i1 >= m_timeslotCapacity || i1 == i2)
+    return false;
+  move.timeslot = t;
+  move.room1 = i1 / m_params.roomSize;
+  move.seat1 = i1 % m_params.roomSize;
+  move.id1 = m_sched.getID(t, move.room1, move.seat1);
+  if (i2 < m_timeslotCapacity) { // Change type 1: swap two seats in time slot
+    move.room2 = i2 / m_params.roomSize;
+    move.seat2 = i2 % m_params.roomSize;
+    move.id2 = m_sched.getID(t, move.room2, move.seat2);
+    if (move.room1 == move.room2 && move.seat1 > 0 && move.seat2 > 0)
+      return false;
+    if ((move.seat1 == 0 && move.id2 >= m_params.nAbstracts) ||
+        (move.seat2 == 0 && move.id1 >= m_params.nAbstracts)) {
+      return false;
+    }
+  } else {  // Change type 2: Swap seat with a free person in time slot
+    move.room2 = move.seat2 = -1;
+    move.id2 = m_sched.getRandomFreePerson(t);
+    if (move.seat1 == 0 && move.id2 >= m_params.nAbstracts) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Index into a best first list, biased towards its start
+static s32 randBiasedIndex(s32 size) {
+  return min(randInt(size), randInt(size));
+}
+
+bool Optimizer::proposeGuidedMove(Move& move) {
+  s32 t = randTimeslot();
+  s32 room = -1;
+  ID personID;
+  if (randInt(2) == 0) {
+    room = randInt(m_params.nRooms);
+    ID abstractID = m_sched.getAbstractID(t, room);
+    if (invalidID(abstractID) || m_params.instance->ratersPerAbstract[abstractID].empty())
+      return false;
+    const vector<ID>& raters = m_params.instance->ratersPerAbstract[abstractID];
+    personID = raters[randBiasedIndex(raters.size())];
+  } else {
+    personID = randInt(m_params.nPeople);
+    if (!findRatedRoom(t, personID, room))
+      return false;
+  }
+  return seatPerson(t, room, 1 + randInt(m_params.roomSize - 1), personID, move);
+}
+
+bool Optimizer::proposeWorstOffMove(Move& move) {
+  ID personID = m_worstOff[randInt(m_worstOff.size())];
+  s32 t = randTimeslot();
+  s32 room;
+  if (!findRatedRoom(t, personID, room))
+    return false;
+  // Of two listener seats of the room, an empty one is filled, else the more
+  // satisfied listener makes way
+  s32 seat = 1 + randInt(m_params.roomSize - 1), other = 1 + randInt(m_params.roomSize - 1);
+  ID seatID = m_sched.getID(t, room, seat), otherID = m_sched.getID(t, room, other);
+  if (validID(seatID) &&
+      (invalidID(otherID) || m_satisfaction[otherID] > m_satisfaction[seatID]))
+    seat = other;
+  return seatPerson(t, room, seat, personID, move);
+}
+
+bool Optimizer::hasWorstOff() {
+  if (m_worstOffRefresh-- > 0)
+    return !m_worstOff.empty();
+  // Every nPeople calls, so that refreshing costs O(1) per move
+  m_worstOffRefresh = m_params.nPeople;
+  m_worstOff.clear();
+  if (!m_scorer.personSatisfaction(m_satisfaction))
+    return false;
+  for (ID personID = 0; personID < m_params.nPeople; ++personID)
+    m_worstOff.push_back(personID);
+  size_t size = min(m_worstOff.size(), size_t(max(0, m_params.worstOffSize)));
+  partial_sort(begin(m_worstOff), begin(m_worstOff) + size, end(m_worstOff),
+               [&](ID p1, ID p2) { return m_satisfaction[p1] < m_satisfaction[p2]; });
+  m_worstOff.resize(size);
+  return !m_worstOff.empty();
+}
+
+bool Optimizer::findRatedRoom(s32 timeslot, ID personID, s32& room) {
+  const vector<ID>& rated = m_params.instance->ratedPerPerson[personID];
+  if (rated.empty())
+    return false;
+  // The first rated abstract presented in the timeslot, from a random place
+  // in the list
+  s32 first = randBiasedIndex(rated.size());
+  for (size_t i = 0; i < rated.size(); ++i) {
+    ID abstractID = rated[(first + i) % rated.size()];
+    for (room = 0; room < m_params.nRooms; ++room) {
+      if (m_sched.getAbstractID(timeslot, room) == abstractID)
+        return true;
+    }
+  }
+  return false;
+}
+
+bool Optimizer::seatPerson(s32 timeslot, s32 room, s32 seat, ID personID, Move& move) {
+  move.timeslot = timeslot;
+  move.room1 = room;
+  move.seat1 = seat;
+  move.id1 = m_sched.getID(timeslot, room, seat);
+  move.id2 = personID;
+  if (m_sched.isFreeID(timeslot, personID)) {
+    move.room2 = move.seat2 = -1;
+    return true;
+  }
+  // Presenters stay, and listeners of the room are already there
+  return m_sched.findPerson(timeslot, personID, move.room2, move.seat2) && move.seat2 > 0 &&
+         move.room2 != room;
+}
+
+bool applyMove(Schedule& sched, Scorer& scorer, const Move& move) {
+  s32 t = move.timeslot;
+  if (move.isSwap()) {
+    scorer.prepareSwapChange(t, move.room1, move.seat1, t, move.room2, move.seat2);
+    if (!swapIfLegal(sched, t, move.room1, move.seat1, move.room2, move.seat2))
+      return false;
+  } else {
+    scorer.prepareSetChange(t, move.room1, move.seat1, move.id2);
+    if (!sched.setIDIfLegal(t, move.room1, move.seat1, move.id2))
+      return false;
+  }
+  scorer.tryChange();
+  return true;
+}
+
+void undoMove(Schedule& sched, Scorer& scorer, const Move& move) {
+  s32 t = move.timeslot;
+  if (move.isSwap()) {
+    sched.setIDUnsafe(t, move.room2, move.seat2, INVALID_ID);
+    sched.setIDUnsafe(t, move.room1, move.seat1, move.id1);
+    sched.setIDUnsafe(t, move.room2, move.seat2, move.id2);
+  } else {
+    sched.setIDUnsafe(t, move.room1, move.seat1, move.id1);
+  }
+  scorer.undoChange();
+}
+
+bool swapIfLegal(Schedule& sched, s32 timeslot, s32 room1, s32 seat1, s32 room2, s32 seat2) {
+  ID id1 = sched.getID(timeslot, room1, seat1);
+  ID id2 = sched.getID(timeslot, room2, seat2);
+  if (!sched.setIDIfLegal(timeslot, room2, seat2, INVALID_ID))
+    return false;
+  if (!sched.setIDIfLegal(timeslot, room1, seat1, id2)) {
+    sched.setIDUnsafe(timeslot, room2, seat2, id2);
+    return false;
+  }
+  if (!sched.setIDIfLegal(timeslot, room2, seat2, id1)) {
+    sched.setIDUnsafe(timeslot, room1, seat1, id1);
+    sched.setIDUnsafe(timeslot, room2, seat2, id2);
+    return false;
+  }
+  return true;
+}
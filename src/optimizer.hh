@@ -0,0 +1,154 @@
+#pragma once
+
+#include "defs.hh"
+#include "params.hh"
+#include "utils.hh"
+#include "schedule.hh"
+#include "scorer.hh"
+#include "profile.hh"
+
+#include <string>
+#include <vector>
+
+
+// A single change in one timeslot: either a swap of two seats or replacing
+// the person in a seat with a person who's free in that timeslot.
+struct Move {
+  s32 timeslot;
+  s32 room1, seat1;
+  s32 room2, seat2; // seat2 < 0 for a change to a free person
+  ID id1, id2;      // IDs before the move (id2 is the free person if no swap)
+
+  bool isSwap() const { return seat2 >= 0; }
+};
+
+// Applies the move if legal and updates the scorer
+bool applyMove(Schedule& sched, Scorer& scorer, const Move& move);
+// Reverts an applied move, including the scorer
+void undoMove(Schedule& sched, Scorer& scorer, const Move& move);
+bool swapIfLegal(Schedule& sched, s32 timeslot, s32 room1, s32 seat1, s32 room2, s32 seat2);
+
+// Base class for search engines working on a schedule through a scorer.
+// Keeps track of the best schedule found and saves it to the results dir.
+class Optimizer {
+public:
+  Optimizer(Schedule& sched, const Options& params, Scorer& scorer) :
+    m_sched(sched), m_scorer(scorer), m_params(params), m_iter(0),
+    m_timeslotCapacity(m_params.nRooms * m_params.roomSize),
+    m_bestScore(0), m_bestIter(0), m_bestSched(sched), m_upperBound(-1),
+    m_worstOffRefresh(0) {}
+  virtual ~Optimizer() = default;
+
+  virtual bool run() = 0;
+
+  void outputSchedSummary(std::ostream& s);
+  void outputSchedStats(std::ostream& s, const Schedule& sched);
+  // Calls Options::onProgress, if set. Engines call it with their status
+  // lines, and runPhases once the phase ends, with its final iteration.
+  void reportProgress();
+
+  const Schedule& bestSchedule() {
+    m_bestSched.setAllIDs(m_bestSchedule);
+    return m_bestSched;
+  }
+
+  const Schedule& curSchedule() {
+    return m_sched;
+  }
+
+  // Limits the moves to the given timeslots (all timeslots if empty)
+  void restrictTimeslots(const std::vector<s32>& timeslots) { m_timeslots = timeslots; }
+
+  // Score changes of up to maxSamples random legal moves from the current
+  // schedule. The schedule is left unchanged.
+  std::vector<Score> sampleScoreDeltas(s32 maxSamples);
+
+  // Sets the working schedule back to the best one found
+  void restoreBest() {
+    if (m_bestSchedule.empty())
+      return;
+    m_sched.setAllIDs(m_bestSchedule);
+    m_scorer.recalcScore();
+  }
+
+protected:
+  Schedule& m_sched;
+  Scorer& m_scorer;
+  const Options m_params;
+  u64 m_iter;
+  const s32 m_timeslotCapacity;
+  std::vector<s32> m_timeslots;
+  Score m_bestScore;
+  u64 m_bestIter;
+  std::vector<ID> m_bestSchedule;
+  Schedule m_bestSched;
+  time_point m_startTime;
+  Score m_upperBound; // Computed on first use, < 0 before
+  std::vector<ID> m_worstOff;       // Least satisfied first
+  std::vector<Score> m_satisfaction; // Per person, as of the last refresh
+  s32 m_worstOffRefresh;            // Calls of hasWorstOff() until a refresh
+
+  std::string inResultsDir(std::string name);
+
+  bool handleNewBest() {
+    PROFILE_SCOPE(BestSnapshot);
+    m_sched.getAllIDs(m_bestSchedule);
+    m_bestIter = m_iter;
+    return true;
+  }
+
+  Score upperBound() {
+    if (m_upperBound < 0)
+      m_upperBound = m_scorer.upperBound();
+    return m_upperBound;
+  }
+  // Relative gap between the best score and the scorer's upper bound
+  double gap() { return (upperBound() - m_bestScore) / upperBound(); }
+  // The upper bound can cost more than a short phase, so it's only computed
+  // for --target_gap or --report_gap
+  bool usesGap() const { return m_params.targetGap > 0 || m_params.reportGap; }
+  std::ostream& outputGap(std::ostream& s) {
+    return usesGap() ? s << " gap: " << (100 * gap()) << "%" : s;
+  }
+  // True once the best score is within --target_gap of the upper bound,
+  // hasn't improved for --stall_iterations, the phase is out of time or the
+  // run was cancelled.
+  // Engines stopping on it restore the best schedule.
+  bool reachedStopCondition();
+
+  bool saveBest();
+
+  // Picks a uniformly random move, or with probability --worst_off_moves
+  // (if the scorer tracks satisfaction) one for the least satisfied people
+  // and with probability --guided_moves a guided one. Returns false for moves which can't change anything or
+  // can't be legal.
+  bool proposeMove(Move& move);
+  bool proposeUniformMove(Move& move);
+  // The constraints file allows both people of the move in their new seats
+  bool constraintsAllow(const Move& move);
+  // Seats a person in a room presenting an abstract they rated: a rater of
+  // a random room's abstract, or a random person with ratings in the room
+  // of one of their rated abstracts. Better rated pairs are more likely.
+  bool proposeGuidedMove(Move& move);
+  // Seats one of the --worst_off_size least satisfied people in a room
+  // presenting an abstract they rated, in place of a more satisfied listener
+  bool proposeWorstOffMove(Move& move);
+  // Refreshes the least satisfied people now and then. False if the scorer
+  // doesn't track satisfaction.
+  bool hasWorstOff();
+  // A room of the timeslot presenting an abstract the person rated, the
+  // better rated ones more likely
+  bool findRatedRoom(s32 timeslot, ID personID, s32& room);
+  // The move putting the person in the seat, from their seat or from free
+  bool seatPerson(s32 timeslot, s32 room, s32 seat, ID personID, Move& move);
+  s32 randTimeslot() {
+    return m_timeslots.empty() ? randInt(m_params.nTimeslots) :
+                                 m_timeslots[randInt(m_timeslots.size())];
+  }
+  bool applyMove(const Move& move) { return ::applyMove(m_sched, m_scorer, move); }
+  void undoMove(const Move& move) { ::undoMove(m_sched, m_scorer, move); }
+
+  // Engine specific state written to the metadata file
+  virtual void outputMetadata(std::ostream& s) {}
+
+};
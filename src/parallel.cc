@@ -0,0 +1,166 @@
+#include "parallel.hh"
+#include "annealing.hh"
+
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+
+ParallelAnnealing::ParallelAnnealing(Schedule& sched, const Options& params, Scorer& scorer,
+                                     ScorerFactory scorerFactory) :
+  Optimizer(sched, params, scorer), m_scorerFactory(scorerFactory),
+  m_threadParams(params),
+  m_nThreads(max(1, min(params.threads, params.nTimeslots))),
+  m_epoch(0), m_temperature(params.initTemp) {
+  m_threadParams.maxIterations = params.maxIterations / m_nThreads;
+}
+
+bool ParallelAnnealing::run() {
+  m_startTime = chrono::system_clock::now();
+  m_bestScore = m_scorer.score();
+  handleNewBest();
+  const u64 threadIterations = m_threadParams.maxIterations;
+  const u64 epochIterations = max(u64(1), m_params.epochIterations);
+
+  // Per thread schedules, scorers and annealers. Created here, so the
+  // threads themselves only run the annealing.
+  vector<unique_ptr<Schedule>> scheds;
+  vector<unique_ptr<Scorer>> scorers;
+  vector<unique_ptr<SimAnnealing>> annealers;
+  for (s32 k = 0; k < m_nThreads; ++k) {
+    scheds.emplace_back(new Schedule(m_sched));
+    scorers.push_back(m_scorerFactory(*scheds[k]));
+    annealers.emplace_back(new SimAnnealing(*scheds[k], m_threadParams, *scorers[k]));
+  }
+
+  double nextOutputSec = 0;
+  vector<ID> ids, threadIDs;
+  const s32 timeslotSize = m_params.nRooms * m_params.roomSize;
+  for (u64 first = 0; first < threadIterations; first += epochIterations, ++m_epoch) {
+    u64 last = min(first + epochIterations, threadIterations);
+
+    // Divide the timeslots randomly between the threads
+    vector<s32> order(m_params.nTimeslots);
+    for (s32 t = 0; t < m_params.nTimeslots; ++t)
+      order[t] = t;
+    for (s32 i = m_params.nTimeslots - 1; i > 0; --i)
+      swap(order[i], order[randInt(i + 1)]);
+    vector<vector<s32>> timeslots(m_nThreads);
+    vector<s32> timeslotThread(m_params.nTimeslots);
+    for (s32 i = 0; i < m_params.nTimeslots; ++i) {
+      timeslots[i % m_nThreads].push_back(order[i]);
+      timeslotThread[order[i]] = i % m_nThreads;
+    }
+
+    m_sched.getAllIDs(ids);
+    for (s32 k = 0; k < m_nThreads; ++k) {
+      scheds[k]->setAllIDs(ids);
+      limitToThread(m_sched, *scheds[k], m_params, k, m_nThreads, timeslotThread, m_epoch);
+      scorers[k]->recalcScore();
+      annealers[k]->restrictTimeslots(timeslots[k]);
+    }
+    // Each thread gets its own stream of the epoch's seed
+    const u64 epochSeed = randNext();
+
+    vector<thread> threads;
+    vector<char> succeeded(m_nThreads, false);
+    for (s32 k = 0; k < m_nThreads; ++k) {
+      threads.emplace_back([&, k]() {
+        randSetSeed(epochSeed, k);
+        succeeded[k] = annealers[k]->anneal(first, last, false);
+      });
+    }
+    for (thread& th : threads)
+      th.join();
+
+    // Merge every thread's timeslots into the schedule
+    for (s32 k = 0; k < m_nThreads; ++k) {
+      if (!succeeded[k])
+        return false;
+      scheds[k]->getAllIDs(threadIDs);
+      for (s32 t : timeslots[k]) {
+        copy(threadIDs.begin() + t * timeslotSize, threadIDs.begin() + (t + 1) * timeslotSize,
+             ids.begin() + t * timeslotSize);
+      }
+    }
+    m_sched.setAllIDs(ids);
+    m_scorer.recalcScore();
+    m_temperature = annealers[0]->temperature();
+    m_iter = last * m_nThreads;
+
+    if (m_scorer.score() > m_bestScore) {
+      if (!handleNewBest())
+        return false;
+      m_bestScore = m_scorer.score();
+    }
+    if (elapsedSecs(m_startTime) >= nextOutputSec) {
+      if (!outputStatus(dbg()))
+        return false;
+      nextOutputSec += m_params.progressSeconds;
+    }
+    if (reachedStopCondition()) {
+      restoreBest();
+      break;
+    }
+  }
+  return outputStatus(info());
+}
+
+// Share of the slack given to a thread, the remainder rotates with offset
+static s32 slackShare(s32 slack, s32 thread, s32 nThreads, u64 offset) {
+  return slack / nThreads + (((thread + offset) % nThreads) < u64(slack % nThreads) ? 1 : 0);
+}
+
+void limitToThread(Schedule& sched, Schedule& threadSched, const Options& params, s32 thread,
+                   s32 nThreads, const vector<s32>& timeslotThread, u64 rotation) {
+  for (ID personID = 0; personID < params.nPeople; ++personID) {
+    s32 count = sched.getPersonCount(personID);
+    s32 down = max(0, count - static_cast<s32>(params.minParticipations));
+    s32 up = max(0, static_cast<s32>(params.maxParticipations) - count);
+    u64 offset = personID + rotation;
+    threadSched.setPersonCountBounds(personID,
+                                     count - slackShare(down, thread, nThreads, offset),
+                                     count + slackShare(up, thread, nThreads, offset));
+  }
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+    s32 count = sched.getAbstractCount(abstractID);
+    s32 down = max(0, count - 1);
+    s32 up = max(0, static_cast<s32>(params.maxPresentations) - count);
+    u64 offset = abstractID + rotation;
+    threadSched.setAbstractCountBounds(abstractID,
+                                       count - slackShare(down, thread, nThreads, offset),
+                                       count + slackShare(up, thread, nThreads, offset));
+  }
+  // Pairs heard in some timeslot can only move within its thread. Other
+  // pairs can be newly heard only by their owner thread, preferably one
+  // where the abstract is presented.
+  vector<vector<s32>> presentingThreads(params.nAbstracts);
+  for (s32 t = 0; t < params.nTimeslots; ++t) {
+    for (s32 r = 0; r < params.nRooms; ++r) {
+      ID abstractID = sched.getAbstractID(t, r);
+      if (validID(abstractID))
+        presentingThreads[abstractID].push_back(timeslotThread[t]);
+    }
+  }
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+    const vector<s32>& candidates = presentingThreads[abstractID];
+    for (ID personID = 0; personID < params.nPeople; ++personID) {
+      u64 i = personID + rotation;
+      s32 owner = candidates.empty() ? (i % nThreads) : candidates[i % candidates.size()];
+      if (owner != thread && !sched.testPersonAbstract(personID, abstractID))
+        threadSched.blockPersonAbstract(personID, abstractID);
+    }
+  }
+}
+
+bool ParallelAnnealing::outputStatus(ostream& s) {
+  s << "Iter " << double(m_iter) << "/" << double(m_params.maxIterations)
+    << " (" << setprecision(4)
+    << left << (100.0 * m_iter / m_params.maxIterations) << right << "%) epoch: "
+    << m_epoch << " threads: " << m_nThreads << " temperature: " << m_temperature
+    << " score: " << m_scorer.score() << " best so far:" << m_bestScore;
+  outputGap(s) << endl;
+  reportProgress();
+  return saveBest();
+}
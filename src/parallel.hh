@@ -0,0 +1,50 @@
+#pragma once
+
+#include "optimizer.hh"
+
+#include <functional>
+#include <memory>
+
+
+using ScorerFactory = std::function<std::unique_ptr<Scorer>(Schedule&)>;
+
+// Limits the copy of the schedule of one of nThreads threads, which changes
+// only the timeslots timeslotThread gives it, so that the changes of all
+// the threads merge back into the schedule within its bounds (see
+// ParallelAnnealing). The split of the slack and of the pairs rotates with
+// the rotation.
+void limitToThread(Schedule& sched, Schedule& threadSched, const Options& params, s32 thread,
+                   s32 nThreads, const std::vector<s32>& timeslotThread, u64 rotation);
+
+// Simulated annealing of a single chain on several threads. Each epoch the
+// timeslots are divided between the threads, and each thread anneals a copy
+// of the schedule limited to its timeslots. The constraints which couple
+// timeslots stay exact:
+// - The slack of every person's and abstract's count (up to the min/max
+//   bounds) is split between the threads, so their changes can't add up
+//   past the bounds.
+// - A person can newly hear an abstract in one thread only: the thread
+//   where they already hear it, or else the pair's owner for this epoch.
+// The threads' timeslots are merged back at the end of each epoch, and the
+// division of timeslots and slack rotates between epochs.
+class ParallelAnnealing final : public Optimizer {
+public:
+  ParallelAnnealing(Schedule& sched, const Options& params, Scorer& scorer,
+                    ScorerFactory scorerFactory);
+
+  virtual bool run() override;
+
+protected:
+  ScorerFactory m_scorerFactory;
+  Options m_threadParams; // Iterations and temperatures per thread
+  s32 m_nThreads;
+  u64 m_epoch;
+  double m_temperature;
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Epoch: " << m_epoch << std::endl;
+    s << "Temperature: " << m_temperature << std::endl;
+  }
+
+  bool outputStatus(std::ostream& s);
+};
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <random>
 
 #include "utils.hh"
 
@@ -16,32 +18,460 @@ Score parseScore(const string& s, Score defaultScore) {
   return s.empty() ? defaultScore : stoi(s);
 }
 
+Params defaultParams() {
+  Params params;
+  params.instance = make_shared<Instance>();
+  params.resultsDir = "results";
+  params.nPeople = params.nAbstracts = 0;
+  params.nTimeslots = 18;
+  params.nRooms = 9;
+  params.roomSize = 12;
+  std::random_device rd;
+  params.seed = rd();
+  params.maxIterations = 100000;
+  params.engine = "sa";
+  params.threads = 1;
+  params.epochIterations = 50000;
+  params.speculativeBatch = 0;
+  params.initTemp = 10.0;
+  params.finalTemp = 0.00001;
+  params.autoTemp = false;
+  params.targetGap = 0;
+  params.reportGap = false;
+  params.stallIterations = 0;
+  params.maxSeconds = 0;
+  params.sweepThreads = 0;
+  params.progressSeconds = 1;
+  params.feasibilityOnly = false;
+  params.initMethod = "flow";
+  params.lnsRounds = 0;
+  params.descentMoves = 0;
+  params.lnsBlockRooms = 0;
+  params.guidedMoves = 0;
+  params.worstOffSize = 20;
+  params.worstOffMoves = 0;
+  params.softBounds = false;
+  params.penaltyGrowth = 1.02;
+  params.restarts = 0;
+  params.eliteSize = 5;
+  params.relinkCandidates = 10;
+  params.relinkTemp = 0.1;
+  params.initTempFactor = 1;
+  params.tabuCandidates = 50;
+  params.tabuTenure = 20;
+  params.personIdCol = "person_id";
+  params.abstractIdCol = "abstract_id";
+  params.scoreCol = "rating";
+  params.inputDelimiter = ',';
+  params.defaultScore = 0;
+  params.maxScore = 5;
+  params.minScore = 0;
+  params.scoreDelta = 1;
+  params.participationRange = 2;
+  params.avgParticipations = params.minParticipations = params.maxParticipations = 0;
+  params.maxPresentations = 3;
+  params.maxNormScore = params.scoreDelta + params.maxScore;
+  params.minNormScore = params.scoreDelta + params.minScore;
+  return params;
+}
+
+shared_ptr<Instance> editInstance(Params& params) {
+  shared_ptr<Instance> instance = make_shared<Instance>(*params.instance);
+  params.instance = instance;
+  return instance;
+}
+
+void outputOptions(const Options& options, ostream& outStream) {
+  outStream << "Seed: " << options.seed << endl;
+  outStream << "resultsDir: " << options.resultsDir << endl;
+  outStream << "nTimeslots: " << options.nTimeslots << endl;
+  outStream << "nRooms: " << options.nRooms << endl;
+  outStream << "roomSize: " << options.roomSize << endl;
+  outStream << "nPeople: " << options.nPeople << endl;
+  outStream << "nAbstracts: " << options.nAbstracts << endl;
+  outStream << "maxIterations: " << options.maxIterations << endl;
+  outStream << "engine: " << options.engine << endl;
+  outStream << "threads: " << options.threads << endl;
+  outStream << "epochIterations: " << options.epochIterations << endl;
+  outStream << "speculativeBatch: " << options.speculativeBatch << endl;
+  outStream << "initTemp: " << options.initTemp << endl;
+  outStream << "finalTemp: " << options.finalTemp << endl;
+  outStream << "autoTemp: " << options.autoTemp << endl;
+  outStream << "targetGap: " << options.targetGap << endl;
+  outStream << "reportGap: " << options.reportGap << endl;
+  outStream << "stallIterations: " << options.stallIterations << endl;
+  outStream << "maxSeconds: " << options.maxSeconds << endl;
+  outStream << "progressSeconds: " << options.progressSeconds << endl;
+  outStream << "initMethod: " << options.initMethod << endl;
+  outStream << "lnsRounds: " << options.lnsRounds << endl;
+  outStream << "lnsBlockRooms: " << options.lnsBlockRooms << endl;
+  outStream << "guidedMoves: " << options.guidedMoves << endl;
+  outStream << "worstOffSize: " << options.worstOffSize << endl;
+  outStream << "worstOffMoves: " << options.worstOffMoves << endl;
+  outStream << "softBounds: " << options.softBounds << endl;
+  outStream << "penaltyGrowth: " << options.penaltyGrowth << endl;
+  outStream << "tabuCandidates: " << options.tabuCandidates << endl;
+  outStream << "tabuTenure: " << options.tabuTenure << endl;
+  outStream << "maxScore: " << options.maxScore << endl;
+  outStream << "minScore: " << options.minScore << endl;
+  outStream << "scoreDelta: " << options.scoreDelta << endl;
+  outStream << "minParticipations: " << options.minParticipations << endl;
+  outStream << "maxParticipations: " << options.maxParticipations << endl;
+  outStream << "maxPresentations: " << options.maxPresentations << endl;
+  outStream << "maxNormScore: " << options.maxNormScore << endl;
+  outStream << "minNormScore: " << options.minNormScore << endl;
+}
+
 void outputParams(const Params& params, ostream& outStream) {
-  outStream << "Seed: " << params.seed << endl;
-  outStream << "resultsDir: " << params.resultsDir << endl;
-  outStream << "nTimeslots: " << params.nTimeslots << endl;
-  outStream << "nRooms: " << params.nRooms << endl;
-  outStream << "roomSize: " << params.roomSize << endl;
-  outStream << "nPeople: " << params.nPeople << endl;
-  outStream << "nAbstracts: " << params.nAbstracts << endl;
-  outStream << "maxIterations: " << params.maxIterations << endl;
-  outStream << "initTemp: " << params.initTemp << endl;
-  outStream << "finalTemp: " << params.finalTemp << endl;
+  outputOptions(params, outStream);
+  outStream << "daemonSocket: " << params.daemonSocket << endl;
+  for (size_t i = 0; i < params.phases.size(); ++i) {
+    outStream << "phase " << (i + 1) << ": ";
+    outputPhase(params.phases[i], outStream);
+    outStream << endl;
+  }
+  for (size_t i = 0; i < params.scenarios.size(); ++i) {
+    outStream << "scenario " << (i + 1) << ": ";
+    outputScenario(params.scenarios[i], outStream);
+    outStream << endl;
+  }
+  outStream << "sweepThreads: " << params.sweepThreads << endl;
+  outStream << "feasibilityOnly: " << params.feasibilityOnly << endl;
+  outStream << "descentMoves: " << params.descentMoves << endl;
+  outStream << "constraintsFile: " << params.constraintsFile << endl;
+  outStream << "restarts: " << params.restarts << endl;
+  outStream << "eliteSize: " << params.eliteSize << endl;
+  outStream << "relinkCandidates: " << params.relinkCandidates << endl;
+  outStream << "relinkTemp: " << params.relinkTemp << endl;
+  outStream << "initTempFactor: " << params.initTempFactor << endl;
   outStream << "personIdCol: " << params.personIdCol << endl;
   outStream << "abstractIdCol: " << params.abstractIdCol << endl;
   outStream << "scoreCol: " << params.scoreCol << endl;
   outStream << "inputDelimiter: " << params.inputDelimiter << endl;
   outStream << "defaultScore: " << params.defaultScore << endl;
-  outStream << "maxScore: " << params.maxScore << endl;
-  outStream << "minScore: " << params.minScore << endl;
-  outStream << "scoreDelta: " << params.scoreDelta << endl;
   outStream << "participationRange: " << params.participationRange << endl;
   outStream << "avgParticipations: " << params.avgParticipations << endl;
-  outStream << "minParticipations: " << params.minParticipations << endl;
-  outStream << "maxParticipations: " << params.maxParticipations << endl;
-  outStream << "maxPresentations: " << params.maxPresentations << endl;
-  outStream << "maxNormScore: " << params.maxNormScore << endl;
-  outStream << "minNormScore: " << params.minNormScore << endl;
+}
+
+void outputPhase(const Phase& phase, ostream& outStream) {
+  outStream << "engine=" << phase.engine << ",sum=" << phase.sumWeight
+            << ",min_bonus=" << phase.minBonusWeight << ",fair=" << phase.fairWeight
+            << ",utility=" << phase.fairUtility << ",iterations=" << phase.maxIterations
+            << ",seconds=" << phase.maxSeconds << ",init_temp=" << phase.initTemp
+            << ",final_temp=" << phase.finalTemp << ",auto_temp=" << phase.autoTemp;
+}
+
+void outputScenario(const Scenario& scenario, ostream& outStream) {
+  outStream << "timeslots=" << scenario.nTimeslots << ",rooms=" << scenario.nRooms
+            << ",room_size=" << scenario.roomSize
+            << ",participation_range=" << scenario.participationRange
+            << ",max_presentations=" << scenario.maxPresentations;
+}
+
+vector<Phase> defaultPhases(const Params& params) {
+  Phase phase{params.engine, 1, 0, 0, "log", params.maxIterations, 0,
+              params.initTemp, params.finalTemp, params.autoTemp};
+  vector<Phase> phases;
+  phases.push_back(phase);
+  phase.minBonusWeight = 1;
+  phases.push_back(phase);
+  if (params.descentMoves > 0) {
+    phase.engine = "descent";
+    phase.maxIterations = params.descentMoves;
+    phases.push_back(phase);
+  }
+  if (params.lnsRounds > 0) {
+    phase.engine = "lns";
+    phase.maxIterations = params.lnsRounds;
+    phases.push_back(phase);
+  }
+  return phases;
+}
+
+bool isEngine(const string& engine) {
+  return engine == "sa" || engine == "tabu" || engine == "lns" || engine == "descent";
+}
+
+bool parsePhase(const string& spec, Phase& phase) {
+  vector<string> settings;
+  boost::split(settings, spec, boost::is_any_of(","));
+  for (string setting : settings) {
+    boost::trim(setting);
+    if (setting.empty())
+      continue;
+    size_t eq = setting.find('=');
+    if (eq == string::npos) {
+      err() << "Phase setting should be key=value. Got: " << setting << endl;
+      return false;
+    }
+    string key = boost::trim_copy(setting.substr(0, eq));
+    string value = boost::trim_copy(setting.substr(eq + 1));
+    try {
+      if (key == "engine") {
+        if (!isEngine(value)) {
+          err() << "Phase engine should be 'sa', 'tabu', 'lns' or 'descent'. Got: " << value << endl;
+          return false;
+        }
+        phase.engine = value;
+      } else if (key == "sum") {
+        phase.sumWeight = stod(value);
+      } else if (key == "min_bonus") {
+        phase.minBonusWeight = stod(value);
+      } else if (key == "fair") {
+        phase.fairWeight = stod(value);
+      } else if (key == "utility") {
+        if (value != "log" && value != "sqrt") {
+          err() << "Phase utility should be 'log' or 'sqrt'. Got: " << value << endl;
+          return false;
+        }
+        phase.fairUtility = value;
+      } else if (key == "iterations") {
+        phase.maxIterations = stod(value);
+      } else if (key == "seconds") {
+        phase.maxSeconds = stod(value);
+      } else if (key == "init_temp") {
+        phase.initTemp = stod(value);
+      } else if (key == "final_temp") {
+        phase.finalTemp = stod(value);
+      } else if (key == "auto_temp") {
+        phase.autoTemp = stoi(value) != 0;
+      } else {
+        err() << "Unknown phase setting: " << key << endl;
+        return false;
+      }
+    } catch (const std::logic_error& e) {
+      err() << "Bad value for phase setting " << key << ": " << value << endl;
+      return false;
+    }
+  }
+  if (phase.sumWeight == 0 && phase.minBonusWeight == 0 && phase.fairWeight == 0) {
+    err() << "Phase has no objective: " << spec << endl;
+    return false;
+  }
+  return true;
+}
+
+bool readPhasesFile(const string& filepath, const Phase& defaults, vector<Phase>& phases) {
+  ifstream file(filepath);
+  if (file.bad() || file.fail()) {
+    err() << "Error opening file '" << filepath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  string line;
+  while (getline(file, line)) {
+    boost::trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    Phase phase = defaults;
+    if (!parsePhase(line, phase))
+      return false;
+    phases.push_back(phase);
+  }
+  return true;
+}
+
+bool parseConstraint(const string& line, Constraint& constraint) {
+  vector<string> fields;
+  boost::split(fields, line, boost::is_any_of(","));
+  for (string& field : fields)
+    boost::trim(field);
+  const string& kind = fields[0];
+  try {
+    if (kind == "unavailable" || kind == "no_present") {
+      if (fields.size() < 3) {
+        err() << "Constraint '" << line << "' needs an ID and timeslots" << endl;
+        return false;
+      }
+      constraint.kind = (kind == "unavailable") ? Constraint::UNAVAILABLE : Constraint::NO_PRESENT;
+      constraint.id = stoi(fields[1]);
+      constraint.otherAbstractID = INVALID_ID;
+      constraint.timeslots.clear();
+      for (size_t i = 2; i < fields.size(); ++i) {
+        s32 timeslot = stoi(fields[i]);
+        if (timeslot < 1) {
+          err() << "Timeslots are numbered from 1 in constraint '" << line << "'" << endl;
+          return false;
+        }
+        constraint.timeslots.push_back(timeslot - 1);
+      }
+    } else if (kind == "conflict") {
+      if (fields.size() != 3) {
+        err() << "Constraint '" << line << "' needs two abstract IDs" << endl;
+        return false;
+      }
+      constraint.kind = Constraint::CONFLICT;
+      constraint.id = stoi(fields[1]);
+      constraint.otherAbstractID = stoi(fields[2]);
+      constraint.timeslots.clear();
+    } else {
+      err() << "Unknown constraint: " << kind << endl;
+      return false;
+    }
+  } catch (const std::exception& e) {
+    err() << "Invalid number in constraint '" << line << "'" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool readConstraintsFile(const string& filepath, vector<Constraint>& constraints) {
+  ifstream file(filepath);
+  if (file.bad() || file.fail()) {
+    err() << "Error opening file '" << filepath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  string line;
+  while (getline(file, line)) {
+    boost::trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    Constraint constraint;
+    if (!parseConstraint(line, constraint))
+      return false;
+    constraints.push_back(constraint);
+  }
+  return true;
+}
+
+// Translated ID of the original one, INVALID_ID if it has none
+static ID translatedID(const unordered_map<ID, ID>& origIdToId, ID origID) {
+  auto it = origIdToId.find(origID);
+  return (it == origIdToId.end()) ? INVALID_ID : it->second;
+}
+
+bool compileConstraints(const Params& params, Instance& inst) {
+  inst.hasConstraints = !inst.constraints.empty();
+  inst.unavailable.assign(params.nTimeslots, boost::dynamic_bitset<>(params.nPeople));
+  inst.cantPresent.assign(params.nTimeslots, boost::dynamic_bitset<>(params.nAbstracts));
+  inst.conflicts.assign(params.nAbstracts, boost::dynamic_bitset<>(params.nAbstracts));
+  for (const Constraint& constraint : inst.constraints) {
+    if (constraint.kind == Constraint::UNAVAILABLE) {
+      ID personID = translatedID(inst.personOrigIdToId, constraint.id);
+      if (invalidID(personID)) {
+        err() << "Unknown person in constraints: " << constraint.id << endl;
+        return false;
+      }
+      for (s32 t : constraint.timeslots) {
+        if (t < params.nTimeslots)
+          inst.unavailable[t].set(personID);
+      }
+    } else {
+      ID abstractID = translatedID(inst.abstractOrigIdToId, constraint.id);
+      ID otherID = (constraint.kind == Constraint::CONFLICT) ?
+        translatedID(inst.abstractOrigIdToId, constraint.otherAbstractID) : abstractID;
+      if (invalidID(abstractID) || invalidID(otherID)) {
+        err() << "Unknown abstract in constraints: "
+              << (invalidID(abstractID) ? constraint.id : constraint.otherAbstractID) << endl;
+        return false;
+      }
+      if (constraint.kind == Constraint::CONFLICT) {
+        inst.conflicts[abstractID].set(otherID);
+        inst.conflicts[otherID].set(abstractID);
+        continue;
+      }
+      for (s32 t : constraint.timeslots) {
+        if (t < params.nTimeslots)
+          inst.cantPresent[t].set(abstractID);
+      }
+    }
+  }
+  return true;
+}
+
+static bool setScenarioValue(const string& key, const string& value, Scenario& scenario) {
+  try {
+    if (key == "timeslots") {
+      scenario.nTimeslots = stoi(value);
+    } else if (key == "rooms") {
+      scenario.nRooms = stoi(value);
+    } else if (key == "room_size") {
+      scenario.roomSize = stoi(value);
+    } else if (key == "participation_range") {
+      scenario.participationRange = stoul(value);
+    } else if (key == "max_presentations") {
+      scenario.maxPresentations = stoul(value);
+    } else {
+      err() << "Unknown scenario setting: " << key << endl;
+      return false;
+    }
+  } catch (const std::logic_error& e) {
+    err() << "Bad value for scenario setting " << key << ": " << value << endl;
+    return false;
+  }
+  if (scenario.nTimeslots < 1 || scenario.nRooms < 1 || scenario.roomSize < 2) {
+    err() << "Scenario needs at least one timeslot, one room and two seats per room" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool parseScenario(const string& spec, Scenario& scenario) {
+  vector<string> settings;
+  boost::split(settings, spec, boost::is_any_of(","));
+  for (string setting : settings) {
+    boost::trim(setting);
+    if (setting.empty())
+      continue;
+    size_t eq = setting.find('=');
+    if (eq == string::npos) {
+      err() << "Scenario setting should be key=value. Got: " << setting << endl;
+      return false;
+    }
+    if (!setScenarioValue(boost::trim_copy(setting.substr(0, eq)),
+                          boost::trim_copy(setting.substr(eq + 1)), scenario))
+      return false;
+  }
+  return true;
+}
+
+bool readScenariosFile(const string& filepath, const Scenario& defaults,
+                       vector<Scenario>& scenarios) {
+  ifstream file(filepath);
+  if (file.bad() || file.fail()) {
+    err() << "Error opening file '" << filepath << "': " << strerror(errno) << endl;
+    return false;
+  }
+  string line;
+  while (getline(file, line)) {
+    boost::trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    Scenario scenario = defaults;
+    if (!parseScenario(line, scenario))
+      return false;
+    scenarios.push_back(scenario);
+  }
+  return true;
+}
+
+bool expandScenarioGrid(const vector<string>& axes, const Scenario& defaults,
+                        vector<Scenario>& scenarios) {
+  vector<Scenario> grid(1, defaults);
+  for (const string& axis : axes) {
+    size_t eq = axis.find('=');
+    if (eq == string::npos) {
+      err() << "Sweep axis should be key=value,value,... Got: " << axis << endl;
+      return false;
+    }
+    string key = boost::trim_copy(axis.substr(0, eq));
+    vector<string> values;
+    boost::split(values, axis.substr(eq + 1), boost::is_any_of(","));
+    vector<Scenario> expanded;
+    for (const Scenario& scenario : grid) {
+      for (string value : values) {
+        boost::trim(value);
+        if (value.empty())
+          continue;
+        Scenario cur = scenario;
+        if (!setScenarioValue(key, value, cur))
+          return false;
+        expanded.push_back(cur);
+      }
+    }
+    grid.swap(expanded);
+  }
+  scenarios.insert(end(scenarios), begin(grid), end(grid));
+  return true;
 }
 
 // Reading input functions
@@ -60,12 +490,12 @@ vector<string> parseCsvLine(string line, size_t expectedItems) {
   return res;
 }
 
-bool normalizeRankings(Params& params) {
+bool normalizeRankings(const Params& params, Instance& inst) {
   vector<Score> personSumScores(params.nPeople, 0), abstractSumScores(params.nAbstracts, 0);
   vector<ID> peopleWithoutRankings;
   for (ID personID = 0; personID < params.nPeople; ++personID) {
     for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
-      Score ranking = getRanking(personID, abstractID, params);
+      Score ranking = getRanking(personID, abstractID, inst.rankings, params.nPeople);
       personSumScores[personID] += ranking;
       abstractSumScores[abstractID] += ranking;
     }
@@ -86,7 +516,7 @@ bool normalizeRankings(Params& params) {
     for (Score s = params.maxScore; s >= params.minScore; --s) {
       for (s32 i=0; i < params.nTimeslots && iAbstract < sortedAbstracts.size(); ++i) {
         Score score = s + params.scoreDelta;
-        setRanking(personID, sortedAbstracts[iAbstract++], params, score);
+        setRanking(personID, sortedAbstracts[iAbstract++], inst.rankings, params.nPeople, score);
         sumScore += score;
       }
     }
@@ -107,24 +537,55 @@ bool normalizeRankings(Params& params) {
   for (ID personID = 0; personID < params.nPeople; ++personID) {
     for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
       if (personFactor[personID] == -1) {
-        setRanking(personID, abstractID, params, 2 * epsilonScore);
+        setRanking(personID, abstractID, inst.rankings, params.nPeople, 2 * epsilonScore);
       } else {
-        Score origScore = getRanking(personID, abstractID, params);
+        Score origScore = getRanking(personID, abstractID, inst.rankings, params.nPeople);
         if (origScore == 0) {
-          setRanking(personID, abstractID, params, epsilonScore);
+          setRanking(personID, abstractID, inst.rankings, params.nPeople, epsilonScore);
         } else {
-          setRanking(personID, abstractID, params, origScore / personFactor[personID]);
+          setRanking(personID, abstractID, inst.rankings, params.nPeople,
+                     origScore / personFactor[personID]);
         }
       }
     }
   }
+  buildRaterIndex(params, inst);
+  inst.bounds = make_shared<BoundCache>();
   return true;
 }
 
-bool translateOrigIDs(Params& params) {
+void buildRaterIndex(const Params& params, Instance& inst) {
+  const Score filler = fillerScore(params);
+  inst.ratersPerAbstract.assign(params.nAbstracts, vector<ID>());
+  inst.ratedPerPerson.assign(params.nPeople, vector<ID>());
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+    for (ID personID = 0; personID < params.nPeople; ++personID) {
+      if (getRanking(personID, abstractID, inst.rankings, params.nPeople) > filler) {
+        inst.ratersPerAbstract[abstractID].push_back(personID);
+        inst.ratedPerPerson[personID].push_back(abstractID);
+      }
+    }
+  }
+  for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+    stable_sort(begin(inst.ratersPerAbstract[abstractID]), end(inst.ratersPerAbstract[abstractID]),
+                [&](ID p1, ID p2) {
+                  return getRanking(p1, abstractID, inst.rankings, params.nPeople) >
+                         getRanking(p2, abstractID, inst.rankings, params.nPeople);
+                });
+  }
+  for (ID personID = 0; personID < params.nPeople; ++personID) {
+    stable_sort(begin(inst.ratedPerPerson[personID]), end(inst.ratedPerPerson[personID]),
+                [&](ID a1, ID a2) {
+                  return getRanking(personID, a1, inst.rankings, params.nPeople) >
+                         getRanking(personID, a2, inst.rankings, params.nPeople);
+                });
+  }
+}
+
+static bool translateOrigIDs(Params& params, Instance& inst) {
   // Translate original IDs to be 0..n by sorting from smallest to biggest
-  set<ID> personIdSet(params.unrankedPersonIDs), abstractIdSet(params.unrankedAbstractIDs);
-  for (auto const& x : params.origRankings) {
+  set<ID> personIdSet(inst.unrankedPersonIDs), abstractIdSet(inst.unrankedAbstractIDs);
+  for (auto const& x : inst.origRankings) {
     ID personID = x.first.first, abstractID = x.first.second;
     personIdSet.insert(personID);
     abstractIdSet.insert(abstractID);
@@ -133,41 +594,78 @@ bool translateOrigIDs(Params& params) {
     personIdSet.erase(abstractID); // Keep only people IDs without an abstract
   }
 
-  params.abstractIdToOrig.assign(begin(abstractIdSet), end(abstractIdSet));
-  sort(begin(params.abstractIdToOrig), end(params.abstractIdToOrig));
+  inst.abstractIdToOrig.assign(begin(abstractIdSet), end(abstractIdSet));
+  sort(begin(inst.abstractIdToOrig), end(inst.abstractIdToOrig));
 
   vector<ID> nonAbstractPeople;
   nonAbstractPeople.assign(begin(personIdSet), end(personIdSet));
   sort(begin(nonAbstractPeople), end(nonAbstractPeople));
 
-  params.personIdToOrig.assign(begin(params.abstractIdToOrig),
-                               end(params.abstractIdToOrig));
-  params.personIdToOrig.insert(end(params.personIdToOrig),
+  inst.personIdToOrig.assign(begin(inst.abstractIdToOrig),
+                               end(inst.abstractIdToOrig));
+  inst.personIdToOrig.insert(end(inst.personIdToOrig),
     begin(nonAbstractPeople), end(nonAbstractPeople));
 
-  for (ID id=0; id < static_cast<ID>(params.personIdToOrig.size()); ++id)
-    params.personOrigIdToId[params.personIdToOrig[id]] = id;
-  for (ID id=0; id < static_cast<ID>(params.abstractIdToOrig.size()); ++id)
-    params.abstractOrigIdToId[params.abstractIdToOrig[id]] = id;
+  for (ID id=0; id < static_cast<ID>(inst.personIdToOrig.size()); ++id)
+    inst.personOrigIdToId[inst.personIdToOrig[id]] = id;
+  for (ID id=0; id < static_cast<ID>(inst.abstractIdToOrig.size()); ++id)
+    inst.abstractOrigIdToId[inst.abstractIdToOrig[id]] = id;
 
-  params.nPeople = params.personIdToOrig.size();
-  params.nAbstracts = params.abstractIdToOrig.size();
+  params.nPeople = inst.personIdToOrig.size();
+  params.nAbstracts = inst.abstractIdToOrig.size();
 
-  params.rankings.assign(params.nPeople * params.nAbstracts, 0);
+  inst.rankings.assign(params.nPeople * params.nAbstracts, 0);
   // Translate original ratings to normalized ratings
-  for (auto const& x : params.origRankings) {
-    ID personID = params.personOrigIdToId[x.first.first];
-    ID abstractID = params.abstractOrigIdToId[x.first.second];
+  for (auto const& x : inst.origRankings) {
+    ID personID = inst.personOrigIdToId[x.first.first];
+    ID abstractID = inst.abstractOrigIdToId[x.first.second];
     Score score = x.second;
-    setRanking(personID, abstractID, params, score);
+    setRanking(personID, abstractID, inst.rankings, params.nPeople, score);
     // dbg() << "personID:" << personID << " abstractID:" << abstractID
     //       << " score:" << score << " score2: " << getRanking(personID, abstractID, params) << endl;
   }
-  params.rankingsOrigScores = params.rankings;
+  inst.rankingsOrigScores = inst.rankings;
+  inst.nRatedPerPerson.assign(params.nPeople, 0);
+  inst.nRatingsPerAbstract.assign(params.nAbstracts, 0);
+  for (ID personID = 0; personID < params.nPeople; ++personID) {
+    for (ID abstractID = 0; abstractID < params.nAbstracts; ++abstractID) {
+      if (getRanking(personID, abstractID, inst.rankingsOrigScores, params.nPeople) > 0) {
+        ++inst.nRatedPerPerson[personID];
+        ++inst.nRatingsPerAbstract[abstractID];
+      }
+    }
+  }
 
   return true;
 }
 
+bool prepareRankings(Params& params) {
+  shared_ptr<Instance> inst = editInstance(params);
+  inst->personOrigIdToId.clear();
+  inst->abstractOrigIdToId.clear();
+  if (!translateOrigIDs(params, *inst))
+    return false;
+  return normalizeRankings(params, *inst) && compileConstraints(params, *inst);
+}
+
+void calcParticipationBounds(Params& params) {
+  params.avgParticipations = round(double(params.nTimeslots * params.nRooms * (params.roomSize - 1)) / params.nPeople);
+  // In signed arithmetic, a range above the average doesn't wrap around
+  params.minParticipations = max(0.0, ceil(double(params.avgParticipations) - params.participationRange));
+  params.maxParticipations = floor(params.avgParticipations + params.participationRange);
+}
+
+void addRating(Instance& inst, ID personID, ID abstractID, Score score) {
+  bool validPersonID = (personID != INVALID_ID);
+  bool validAbstractID = (abstractID != INVALID_ID);
+  if (!validPersonID && validAbstractID)
+    inst.unrankedAbstractIDs.insert(abstractID);
+  if (!validAbstractID && validPersonID)
+    inst.unrankedPersonIDs.insert(personID);
+  if (validPersonID && validAbstractID && score > 0)
+    inst.origRankings[make_pair(personID, abstractID)] = score;
+}
+
 bool readRankings(const string& filepath, Params& params) {
   ifstream f(filepath);
   if (f.bad() || f.fail()) {
@@ -205,11 +703,12 @@ bool readRankings(const string& filepath, Params& params) {
 
   int nlines = 0;
   stringstream scoreWarn;
+  shared_ptr<Instance> inst = editInstance(params);
   while (getline(f, line)) {
     line = line + "\n";
     stringstream lineStr(line);
-    ID personID, abstractID;
-    Score score;
+    ID personID = INVALID_ID, abstractID = INVALID_ID;
+    Score score = 0;
     for (int i = 0; i < max_idx; i++) {
       if (!getline(lineStr, cell, delim)) {
         err() << "Not enough cells in row " << (nlines + 1)
@@ -239,19 +738,10 @@ bool readRankings(const string& filepath, Params& params) {
       }
     }
 
-    bool validPersonID = (personID != INVALID_ID);
-    bool validAbstractID = (abstractID != INVALID_ID);
-    if (!validPersonID && validAbstractID)
-      params.unrankedAbstractIDs.insert(abstractID);
-    if (!validAbstractID && validPersonID)
-      params.unrankedPersonIDs.insert(personID);
-    if (validPersonID && validAbstractID && score > 0)
-      params.origRankings[make_pair(personID, abstractID)] = score;
+    addRating(*inst, personID, abstractID, score);
     ++nlines;
   }
-  if (!translateOrigIDs(params))
-    return false;
-  if (!normalizeRankings(params))
+  if (!prepareRankings(params))
     return false;
   if (!scoreWarn.str().empty()) {
     warn() << scoreWarn.str() << endl;
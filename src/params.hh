@@ -1,45 +1,221 @@
 #pragma once
 
 #include "defs.hh"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
+#include <boost/dynamic_bitset.hpp>
 #include <boost/functional/hash.hpp>
 
 // Algorithm parameters
 using Rankings = std::vector<Score>;
 using OrigRankings = std::unordered_map<std::pair<ID,ID>, Score, boost::hash<std::pair<ID, ID> > >;
 
-struct Params {
+// One phase of the optimization pipeline. Each phase starts from the best
+// schedule of the previous one.
+struct Phase {
+  std::string engine;     // sa, tabu or lns
+  double sumWeight;       // Weight of the sum of ratings
+  double minBonusWeight;  // Weight of the least satisfied person's bonus
+  double fairWeight;      // Weight of the sum of concave utilities of satisfaction
+  std::string fairUtility; // log or sqrt
+  u64 maxIterations;      // Iterations (repairs for lns)
+  double maxSeconds;      // 0 for no time limit
+  double initTemp, finalTemp;
+  bool autoTemp;
+};
+
+// Event dimensions and limits of one configuration of a sweep
+struct Scenario {
+  s32 nTimeslots, nRooms, roomSize;
+  u32 participationRange;
+  u32 maxPresentations;
+};
+
+// A hard rule of the constraints file, in original IDs
+struct Constraint {
+  enum Kind { UNAVAILABLE, NO_PRESENT, CONFLICT };
+  Kind kind;
+  ID id;                      // Person (unavailable) or abstract
+  ID otherAbstractID;         // Conflicting abstract
+  std::vector<s32> timeslots; // From 0
+};
+
+class Schedule;
+
+// Status of a running optimization, reported to Options::onProgress every
+// Options::progressSeconds or so
+struct Progress {
+  size_t phase;      // Index in Params::phases
+  u64 iter;
+  Score score, bestScore;
+  double gap;        // Of the best score to the phase's upper bound, NaN
+                     // unless Options::targetGap > 0 or Options::reportGap
+  double seconds;    // Since the phase started
+  const Schedule* best; // The phase's best schedule so far, during the call
+};
+
+// Upper bounds of an instance's ratings by event shape (timeslots, rooms,
+// room size, max participations and presentations), computed once for all
+// the phases, restarts and runs sharing the instance
+struct BoundCache {
+  std::mutex mutex;
+  std::map<std::tuple<s32, s32, s32, u32, u32>, Score> assignment;
+};
+
+// The ratings, the translation of the original IDs and the compiled
+// constraints: the bulk of the data, which the copies of Params and Options
+// made for each component of a run share read-only
+struct Instance {
   Rankings rankings;
   Rankings rankingsOrigScores;
+  std::vector<s32> nRatedPerPerson, nRatingsPerAbstract; // Original ratings > 0
+  // Pairs rated above the normalization filler, the best rated first
+  std::vector<std::vector<ID>> ratersPerAbstract, ratedPerPerson;
+
+  OrigRankings origRankings;
+  std::vector<ID> personIdToOrig, abstractIdToOrig;
+  std::unordered_map<ID, ID> personOrigIdToId, abstractOrigIdToId;
+  std::set<ID> unrankedPersonIDs, unrankedAbstractIDs;
+  // Hard rules, compiled for O(1) checks once the IDs are translated
+  std::vector<Constraint> constraints;
+  bool hasConstraints = false;
+  std::vector<boost::dynamic_bitset<>> unavailable; // [timeslot][person]
+  std::vector<boost::dynamic_bitset<>> cantPresent; // [timeslot][abstract]
+  std::vector<boost::dynamic_bitset<>> conflicts;   // [abstract][abstract]
+  // Emptied by normalizeRankings(), as the ratings may have changed
+  std::shared_ptr<BoundCache> bounds = std::make_shared<BoundCache>();
+};
+
+// The settings of a single run, which the schedules, scorers and optimizers
+// keep a copy of
+struct Options {
+  // Never null. Changed through editInstance().
+  std::shared_ptr<const Instance> instance;
   std::string resultsDir;
   s32 nPeople, nAbstracts;
   s32 nTimeslots, nRooms, roomSize;
   s32 seed;
   u64 maxIterations;
+  std::string engine;
+  s32 threads;
+  u64 epochIterations;
+  s32 speculativeBatch;
   double initTemp, finalTemp;
-  std::string personIdCol, abstractIdCol, scoreCol;
-  char inputDelimiter;
-  Score defaultScore;
+  bool autoTemp;
+  double targetGap;
+  bool reportGap;       // Compute the upper bound for the logs even without a target gap
+  u64 stallIterations;
+  double maxSeconds;
+  // Set by embedding programs: the run stops (keeping its best schedule)
+  // once *cancel is true, and reports its progress to onProgress
+  const std::atomic<bool>* cancel = nullptr;
+  std::function<void(const Progress&)> onProgress;
+  double progressSeconds; // Also between status lines
+  std::string initMethod;
+  u64 lnsRounds;
+  s32 lnsBlockRooms;
+  double guidedMoves;
+  s32 worstOffSize;
+  double worstOffMoves;
+  bool softBounds;      // Penalize instead of forbid count bound violations
+  double penaltyGrowth; // Of the penalty weight, while the schedule violates them
+  s32 tabuCandidates;
+  u32 tabuTenure;
   Score maxScore;
   Score minScore;
   Score scoreDelta;
-  u32 participationRange;
-  u32 avgParticipations;
   u32 minParticipations;
   u32 maxParticipations;
   u32 maxPresentations;
   Score maxNormScore; // = maxScore + scoreDelta
   Score minNormScore; // = minScore + scoreDelta)
+};
 
-  OrigRankings origRankings;
-  std::vector<ID> personIdToOrig, abstractIdToOrig;
-  std::unordered_map<ID, ID> personOrigIdToId, abstractOrigIdToId;
-  std::set<ID> unrankedPersonIDs, unrankedAbstractIDs;
+// The settings of the program: the options of its runs, the phases and sweep
+// scenarios to run and how to read the input
+struct Params : Options {
+  std::string daemonSocket;
+  std::vector<Phase> phases;
+  std::vector<Scenario> scenarios; // Sweep mode if not empty
+  s32 sweepThreads;
+  bool feasibilityOnly; // Only report the feasibility of the settings
+  u64 descentMoves;     // Of the steepest descent polishing, 0 for none
+  s32 restarts;         // Runs of the phases after the first
+  s32 eliteSize;        // Schedules kept from the runs
+  s32 relinkCandidates; // Moves evaluated per path relinking step
+  double relinkTemp;    // Factor of the initial temperature of relinked runs
+  double initTempFactor; // Of every phase's initial temperature, once calibrated
+  std::string constraintsFile;
+  std::string personIdCol, abstractIdCol, scoreCol;
+  char inputDelimiter;
+  Score defaultScore;
+  u32 participationRange;
+  u32 avgParticipations;
 };
 
+// The command line defaults, with a random seed and no ratings
+Params defaultParams();
+// Replaces the instance of the params with a copy to change while building
+// it, so the params sharing the previous one keep it unchanged. The copy
+// shares the bound cache until normalizeRankings() empties it.
+std::shared_ptr<Instance> editInstance(Params& params);
+void outputOptions(const Options& options, std::ostream& outStream);
 void outputParams(const Params& params, std::ostream& outStream);
+void outputPhase(const Phase& phase, std::ostream& outStream);
+void outputScenario(const Scenario& scenario, std::ostream& outStream);
+// Phases run when none are given: annealing (or tabu search) of the sum of
+// ratings, then of the sum with the least satisfied person's bonus, then
+// steepest descent polishing if descentMoves > 0 and LNS polishing if
+// lnsRounds > 0
+std::vector<Phase> defaultPhases(const Params& params);
+// Whether createOptimizer has the engine: sa, tabu, lns or descent
+bool isEngine(const std::string& engine);
+// Parses comma separated key=value settings over the given phase, e.g.
+// "engine=sa,sum=1,min_bonus=1,fair=1,utility=log,iterations=1e6,seconds=60,init_temp=1"
+bool parsePhase(const std::string& spec, Phase& phase);
+// Reads one phase per line, empty lines and lines starting with # skipped
+bool readPhasesFile(const std::string& filepath, const Phase& defaults,
+                    std::vector<Phase>& phases);
+// Parses comma separated key=value settings over the given scenario, e.g.
+// "timeslots=16,rooms=10,room_size=12,participation_range=2,max_presentations=3"
+bool parseScenario(const std::string& spec, Scenario& scenario);
+// Reads one scenario per line, empty lines and lines starting with # skipped
+bool readScenariosFile(const std::string& filepath, const Scenario& defaults,
+                       std::vector<Scenario>& scenarios);
+// Every combination of the axes' values, each axis being a setting with a
+// comma separated list of values, e.g. "rooms=9,10,11"
+bool expandScenarioGrid(const std::vector<std::string>& axes, const Scenario& defaults,
+                        std::vector<Scenario>& scenarios);
+// Parses a constraints file line: "unavailable,person_id,timeslot,...",
+// "no_present,abstract_id,timeslot,..." or "conflict,abstract_id,abstract_id",
+// with timeslots numbered from 1
+bool parseConstraint(const std::string& line, Constraint& constraint);
+// Reads one constraint per line, empty lines and lines starting with # skipped
+bool readConstraintsFile(const std::string& filepath, std::vector<Constraint>& constraints);
+// Builds the bitsets of the constraints into the params' instance, as
+// returned by editInstance(), for the translated IDs. Timeslots past
+// nTimeslots are ignored.
+bool compileConstraints(const Params& params, Instance& instance);
+// Adds a rating as read from the input, in original IDs and with scoreDelta
+// added. An invalid abstract (person) ID only registers the person
+// (abstract) as a participant without ratings.
+void addRating(Instance& instance, ID personID, ID abstractID, Score score);
 bool readRankings(const std::string& filepath, Params& params);
+// Translates origRankings to internal IDs and normalized rankings
+bool prepareRankings(Params& params);
+// Normalizes the translated ratings in rankings of the params' instance, as
+// returned by editInstance(), which depends on nTimeslots, and builds the
+// rater index from them
+bool normalizeRankings(const Params& params, Instance& instance);
+void buildRaterIndex(const Params& params, Instance& instance);
+// Participation range around the average number of listeners per person
+void calcParticipationBounds(Params& params);
 
 inline bool validID(ID id) { return id != INVALID_ID; }
 inline bool invalidID(ID id) { return !validID(id); }
@@ -47,15 +223,16 @@ inline bool invalidID(ID id) { return !validID(id); }
 inline Score getRanking(ID personID, ID abstractID, const Rankings& ranking, int nPeople) {
   return ranking.at((abstractID * nPeople) + personID);
 }
-inline Score getRanking(ID personID, ID abstractID, const Params& params) {
-  return getRanking(personID, abstractID, params.rankings, params.nPeople);
+inline Score getRanking(ID personID, ID abstractID, const Options& params) {
+  return getRanking(personID, abstractID, params.instance->rankings, params.nPeople);
 }
-inline Score getRankingOrig(ID personID, ID abstractID, const Params& params) {
-  return getRanking(personID, abstractID, params.rankingsOrigScores, params.nPeople);
+// Normalization gives unrated pairs at most this score
+inline Score fillerScore(const Options& params) {
+  return 2 * params.minNormScore / (10 * params.nAbstracts);
+}
+inline Score getRankingOrig(ID personID, ID abstractID, const Options& params) {
+  return getRanking(personID, abstractID, params.instance->rankingsOrigScores, params.nPeople);
 }
 inline void setRanking(ID personID, ID abstractID, Rankings& ranking, int nPeople, Score score) {
   ranking[(abstractID * nPeople) + personID] = score;
 }
-inline void setRanking(ID personID, ID abstractID, Params& params, Score score) {
-  setRanking(personID, abstractID, params.rankings, params.nPeople, score);
-}
@@ -0,0 +1,117 @@
+#include "pipeline.hh"
+#include "annealing.hh"
+#include "descent.hh"
+#include "lns.hh"
+#include "tabu.hh"
+#include "speculative.hh"
+
+using namespace std;
+
+
+unique_ptr<Optimizer> createOptimizer(Schedule& sched, const Params& params, Scorer& scorer,
+                                      ScorerFactory scorerFactory) {
+  if (params.engine == "lns")
+    return unique_ptr<Optimizer>(new LargeNeighbourhoodSearch(sched, params, scorer));
+  if (params.engine == "descent")
+    return unique_ptr<Optimizer>(new SteepestDescent(sched, params, scorer, scorerFactory));
+  if (params.engine == "tabu")
+    return unique_ptr<Optimizer>(new TabuSearch(sched, params, scorer));
+  if (params.speculativeBatch > 0)
+    return unique_ptr<Optimizer>(new SpeculativeAnnealing(sched, params, scorer, scorerFactory));
+  if (params.threads > 1)
+    return unique_ptr<Optimizer>(new ParallelAnnealing(sched, params, scorer, scorerFactory));
+  return unique_ptr<Optimizer>(new SimAnnealing(sched, params, scorer));
+}
+
+static unique_ptr<Scorer> scaled(unique_ptr<Scorer> scorer, double weight) {
+  if (weight == 1)
+    return scorer;
+  return unique_ptr<Scorer>(new ScaledScorer(move(scorer), weight));
+}
+
+unique_ptr<Scorer> createScorer(Schedule& sched, const Params& params, const Phase& phase) {
+  unique_ptr<Scorer> res;
+  auto add = [&](unique_ptr<Scorer> scorer, double weight) {
+    scorer = scaled(move(scorer), weight);
+    res = res ? unique_ptr<Scorer>(new SumScorers(move(res), move(scorer))) : move(scorer);
+  };
+  if (phase.sumWeight != 0)
+    add(unique_ptr<Scorer>(new SumHappinessScorer(sched, params)), phase.sumWeight);
+  if (phase.minBonusWeight != 0)
+    add(unique_ptr<Scorer>(new MinHappinessBonusScorer(sched, params)), phase.minBonusWeight);
+  if (phase.fairWeight != 0)
+    add(unique_ptr<Scorer>(new ConcaveFairnessScorer(sched, params, phase.fairUtility)),
+        phase.fairWeight);
+  // Only simulated annealing relaxes the bounds
+  if (params.softBounds && phase.engine == "sa")
+    res = unique_ptr<Scorer>(new SumScorers(move(res),
+      unique_ptr<Scorer>(new BoundsPenaltyScorer(sched, params))));
+  return res;
+}
+
+Params phaseParams(const Params& params, const Phase& phase) {
+  Params res = params;
+  res.engine = phase.engine;
+  res.maxIterations = phase.maxIterations;
+  if (phase.engine == "lns")
+    res.lnsRounds = phase.maxIterations;
+  res.maxSeconds = phase.maxSeconds;
+  res.initTemp = phase.initTemp;
+  res.finalTemp = phase.finalTemp;
+  res.autoTemp = phase.autoTemp;
+  return res;
+}
+
+Params withBudget(const Params& params, u64 iterations, double seconds) {
+  Params res = params;
+  for (Phase& phase : res.phases) {
+    if (iterations > 0)
+      phase.maxIterations = iterations;
+    if (seconds > 0)
+      phase.maxSeconds = seconds;
+  }
+  return res;
+}
+
+bool runPhases(Schedule& sched, const Params& params) {
+  auto& s = dbg();
+  for (size_t i = 0; i < params.phases.size(); ++i) {
+    if (params.cancel && params.cancel->load())
+      break;
+    const Phase& phase = params.phases[i];
+    auto& log = info() << "Phase " << (i + 1) << ": ";
+    outputPhase(phase, log);
+    log << endl;
+    Params curParams = phaseParams(params, phase);
+    if (params.onProgress) {
+      curParams.onProgress = [&params, i](const Progress& progress) {
+        Progress phaseProgress = progress;
+        phaseProgress.phase = i;
+        params.onProgress(phaseProgress);
+      };
+    }
+    unique_ptr<Scorer> scorer = createScorer(sched, params, phase);
+    if (curParams.autoTemp && curParams.engine == "sa")
+      calibrateTemperatures(sched, *scorer, curParams);
+    if (params.initTempFactor != 1)
+      curParams.initTemp = max(curParams.finalTemp, curParams.initTemp * params.initTempFactor);
+    unique_ptr<Optimizer> optimizer = createOptimizer(sched, curParams, *scorer,
+      [&](Schedule& s) { return createScorer(s, params, phase); });
+
+    dbg() << "Stats:" << endl;
+    optimizer->outputSchedStats(s, optimizer->curSchedule());
+    optimizer->outputSchedSummary(s);
+    s << "Score:" << scorer->score() << endl;
+
+    dbg() << "Optimizing schedule" << endl;
+    if (!optimizer->run())
+      return false;
+    // The next phase starts from this phase's best schedule
+    optimizer->restoreBest();
+    optimizer->reportProgress();
+    optimizer->outputSchedSummary(s);
+    optimizer->outputSchedStats(s, optimizer->bestSchedule());
+    s << "Score:" << scorer->score() << endl;
+  }
+  return true;
+}
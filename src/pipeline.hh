@@ -0,0 +1,25 @@
+#pragma once
+
+#include "optimizer.hh"
+#include "parallel.hh"
+
+#include <memory>
+
+
+// Search engine for the params' engine, threads and speculative batch
+std::unique_ptr<Optimizer> createOptimizer(Schedule& sched, const Params& params, Scorer& scorer,
+                                           ScorerFactory scorerFactory);
+
+// The phase's weighted objective
+std::unique_ptr<Scorer> createScorer(Schedule& sched, const Params& params, const Phase& phase);
+
+// Params of a single phase
+Params phaseParams(const Params& params, const Phase& phase);
+
+// Params with every phase's budget replaced by the given one (0 keeps it)
+Params withBudget(const Params& params, u64 iterations, double seconds);
+
+// Runs params.phases in order on the schedule, each starting from the best
+// schedule of the previous one. Leaves the last phase's best schedule.
+// A cancelled run skips the remaining phases.
+bool runPhases(Schedule& sched, const Params& params);
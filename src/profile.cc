@@ -0,0 +1,112 @@
+#include "profile.hh"
+
+#ifdef ALPINE_PROFILE
+
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+
+u64 profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+namespace {
+
+const s32 N_PHASES = static_cast<s32>(ProfilePhase::Count);
+const s32 N_BUCKETS = 64; // Bucket b counts calls taking [2^(b-1), 2^b) ticks
+
+const char* PHASE_NAMES[N_PHASES] = {
+  "Iteration", "Propose", "SetIDIfLegal", "ScorerPrepare", "ScorerTry", "ScorerUndo",
+  "Accept", "BestSnapshot", "SaveBest"
+};
+
+struct ProfileCounters {
+  u64 calls[N_PHASES] = {};
+  u64 ticks[N_PHASES] = {};
+  u64 buckets[N_PHASES][N_BUCKETS] = {};
+
+  void add(const ProfileCounters& other) {
+    for (s32 p = 0; p < N_PHASES; ++p) {
+      calls[p] += other.calls[p];
+      ticks[p] += other.ticks[p];
+      for (s32 b = 0; b < N_BUCKETS; ++b)
+        buckets[p][b] += other.buckets[p][b];
+    }
+  }
+};
+
+mutex finishedMutex;
+ProfileCounters finishedThreads;
+
+// Merged into finishedThreads when the thread exits
+struct ThreadCounters : ProfileCounters {
+  ~ThreadCounters() {
+    lock_guard<mutex> lock(finishedMutex);
+    finishedThreads.add(*this);
+  }
+};
+thread_local ThreadCounters threadCounters;
+
+// Start of the run in both clocks, to convert ticks to seconds
+const chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+const u64 startTicks = profileTicks();
+
+s32 bucketOf(u64 ticks) {
+  s32 b = 0;
+  while (ticks > 0 && b < N_BUCKETS - 1) {
+    ticks >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+}
+
+void profileAdd(ProfilePhase phase, u64 ticks) {
+  s32 p = static_cast<s32>(phase);
+  ++threadCounters.calls[p];
+  threadCounters.ticks[p] += ticks;
+  ++threadCounters.buckets[p][bucketOf(ticks)];
+}
+
+void outputProfile(ostream& s) {
+  ProfileCounters total;
+  {
+    lock_guard<mutex> lock(finishedMutex);
+    total = finishedThreads;
+  }
+  total.add(threadCounters);
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  double nsPerTick = (secs * 1e9) / max(u64(1), profileTicks() - startTicks);
+
+  s << "Profile (all threads, nested phases included):" << endl;
+  s << left << setw(14) << "Phase" << right << setw(14) << "Calls" << setw(12) << "Seconds"
+    << setw(12) << "Mean ns" << "  Latency histogram (calls up to ns)" << endl;
+  for (s32 p = 0; p < N_PHASES; ++p) {
+    if (total.calls[p] == 0)
+      continue;
+    double phaseSecs = total.ticks[p] * nsPerTick / 1e9;
+    s << left << setw(14) << PHASE_NAMES[p] << right << setw(14) << total.calls[p]
+      << setw(12) << setprecision(4) << phaseSecs
+      << setw(12) << (total.ticks[p] * nsPerTick / total.calls[p]) << " ";
+    for (s32 b = 0; b < N_BUCKETS; ++b) {
+      if (total.buckets[p][b] > 0)
+        s << " " << u64((u64(1) << b) * nsPerTick) << ":" << total.buckets[p][b];
+    }
+    s << endl;
+  }
+}
+
+#endif
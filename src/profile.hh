@@ -0,0 +1,52 @@
+#pragma once
+
+#include "defs.hh"
+
+#include <ostream>
+
+
+// Hot path instrumentation, compiled in by building with make PROFILE=1
+// (which defines ALPINE_PROFILE). PROFILE_SCOPE(Phase) times the rest of
+// the enclosing scope with the cycle counter, adding to the calling thread's
+// counters. Nested scopes are included in the enclosing scope's time.
+enum class ProfilePhase {
+  Iteration,
+  Propose,
+  SetIDIfLegal,
+  ScorerPrepare,
+  ScorerTry,
+  ScorerUndo,
+  Accept,
+  BestSnapshot,
+  SaveBest,
+  Count
+};
+
+#ifdef ALPINE_PROFILE
+
+u64 profileTicks();
+void profileAdd(ProfilePhase phase, u64 ticks);
+
+class ProfileTimer final {
+public:
+  explicit ProfileTimer(ProfilePhase phase) : m_phase(phase), m_start(profileTicks()) {}
+  ~ProfileTimer() { profileAdd(m_phase, profileTicks() - m_start); }
+
+private:
+  const ProfilePhase m_phase;
+  const u64 m_start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) \
+  ProfileTimer PROFILE_CONCAT(profileTimer, __LINE__)(ProfilePhase::phase)
+
+// Time per phase and latency histograms of all threads so far
+void outputProfile(std::ostream& s);
+
+#else
+
+#define PROFILE_SCOPE(phase) do {} while (false)
+
+#endif
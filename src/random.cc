@@ -0,0 +1,29 @@
+#include "random.hh"
+
+
+void Rng::setSeed(u64 seed) {
+  // splitmix64, so similar seeds give unrelated states
+  for (u64& s : m_s) {
+    u64 z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    s = z ^ (z >> 31);
+  }
+}
+
+void Rng::jump() {
+  static const u64 JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                              0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  u64 s[4] = {0, 0, 0, 0};
+  for (u64 jump : JUMP) {
+    for (int b = 0; b < 64; ++b) {
+      if (jump & (u64(1) << b)) {
+        for (int i = 0; i < 4; ++i)
+          s[i] ^= m_s[i];
+      }
+      next();
+    }
+  }
+  for (int i = 0; i < 4; ++i)
+    m_s[i] = s[i];
+}
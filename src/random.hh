@@ -0,0 +1,85 @@
+#pragma once
+
+#include "defs.hh"
+
+#include <cstddef>
+#include <vector>
+
+
+// xoshiro256** generator. Seeded through splitmix64, jump() advances it by
+// 2^128 steps, so generators jumped a different number of times give
+// non-overlapping streams.
+class Rng final {
+public:
+  explicit Rng(u64 seed = 0) { setSeed(seed); }
+
+  void setSeed(u64 seed);
+  void jump();
+
+  u64 next() {
+    const u64 result = rotl(m_s[1] * 5, 7) * 9;
+    const u64 t = m_s[1] << 17;
+    m_s[2] ^= m_s[0];
+    m_s[3] ^= m_s[1];
+    m_s[1] ^= m_s[2];
+    m_s[0] ^= m_s[3];
+    m_s[2] ^= t;
+    m_s[3] = rotl(m_s[3], 45);
+    return result;
+  }
+
+protected:
+  u64 m_s[4];
+
+  static u64 rotl(u64 x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Uniform integer in [0, bound), using Lemire's multiply and shift with
+// rejection of the biased low values
+template <typename Source>
+u32 boundedRand(Source& source, u32 bound) {
+  u64 m = u64(u32(source.next() >> 32)) * bound;
+  u32 low = u32(m);
+  if (low < bound) {
+    u32 threshold = -bound % bound;
+    while (low < threshold) {
+      m = u64(u32(source.next() >> 32)) * bound;
+      low = u32(m);
+    }
+  }
+  return m >> 32;
+}
+
+// Uniform double in [0, 1) from the top 53 bits
+inline double bitsToProb(u64 bits) {
+  return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Generator output prefilled a block at a time, keeping the hot path to a
+// load and an index increment. Gives the same sequence as the generator.
+class RandBlock final {
+public:
+  explicit RandBlock(size_t size = 256) : m_values(size), m_pos(size) {}
+
+  void reset(const Rng& rng) {
+    m_rng = rng;
+    m_pos = m_values.size();
+  }
+
+  u64 next() {
+    if (m_pos == m_values.size())
+      refill();
+    return m_values[m_pos++];
+  }
+
+protected:
+  Rng m_rng;
+  std::vector<u64> m_values;
+  size_t m_pos;
+
+  void refill() {
+    for (u64& v : m_values)
+      v = m_rng.next();
+    m_pos = 0;
+  }
+};
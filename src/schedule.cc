@@ -1,7 +1,10 @@
 #include "schedule.hh"
+#include "flow.hh"
+#include "profile.hh"
 
 #include <iomanip>
 #include <algorithm>
+#include <queue>
 
 using namespace std;
 
@@ -9,6 +12,7 @@ using namespace std;
 // Schedule class for managing a round table schedule
 void Schedule::setAllIDs(vector<ID> IDs) {
   ASSERT(IDs.size() == m_nTimeslots * m_nRooms * m_roomSize);
+  reset();
   for (s32 t = 0; t < m_nTimeslots; ++t) {
     for (s32 r = 0; r < m_nRooms; ++r) {
       for (s32 i = 0; i < m_roomSize; ++i) {
@@ -22,12 +26,20 @@ void Schedule::setAllIDs(vector<ID> IDs) {
 
 void Schedule::reset() {
   m_ids.assign(m_nTimeslots * m_nRooms * m_roomSize, INVALID_ID);
-  m_freeIDs.assign(m_nTimeslots * m_nPeople, true);
+  m_personSeats.assign(m_nTimeslots * m_nPeople, -1);
   m_abstractCount.assign(m_nAbstracts, 0);
-  m_maxAbstractScore.assign(m_nAbstracts, 0);
   m_personCount.assign(m_nPeople, 0);
   m_personAbstract.assign(m_nAbstracts * m_nPeople, false);
+  m_nConflicts.assign(m_params.instance->hasConstraints ? m_nTimeslots * m_nAbstracts : 0, 0);
+  m_minPersonCount.assign(m_nPeople, m_params.minParticipations);
+  m_maxPersonCount.assign(m_nPeople, m_params.maxParticipations);
+  m_minAbstractCount.assign(m_nAbstracts, 1);
+  m_maxAbstractCount.assign(m_nAbstracts, m_params.maxPresentations);
+  m_stats.reset();
+}
 
+void Schedule::calcMaxAbstractScore() {
+  m_maxAbstractScore.assign(m_nAbstracts, 0);
   for (ID personID = 0; personID < m_nPeople; ++personID) {
     for (ID abstractID = 0; abstractID < m_nAbstracts; ++abstractID) {
       m_maxAbstractScore[abstractID] += getRanking(personID, abstractID, m_params);
@@ -36,6 +48,16 @@ void Schedule::reset() {
 }
 
 void Schedule::initState() {
+  if (m_params.initMethod == "random") {
+    initPresenters();
+    initListenersRandom();
+  } else {
+    initPresentersByDemand();
+    initListenersByFlow();
+  }
+}
+
+void Schedule::initPresenters() {
   // Assign abstracts: Sort by max potential score. Assign all abstracts,
   // then assign best abstracts one by one, penalizing the max score when
   // an abstract is picked.
@@ -55,14 +77,72 @@ void Schedule::initState() {
   for (s32 r = 0; r < m_nRooms; ++r) {
     for (s32 t = 0; t < m_nTimeslots; ++t) {
       ID abstractID;
+      size_t tries = 0;
       do {
         abstractID = indexes[i];
         i = (i + 1) % indexes.size();
-      } while (!isFreeID(t, abstractID));
+      } while ((!isFreeID(t, abstractID) || !constraintsAllow(t, r, 0, abstractID)) &&
+               ++tries < indexes.size());
+      if (tries == indexes.size()) {
+        dbg() << "Couldn't assign an abstract to timeslot:" << t << " room:" << r << endl;
+        continue;
+      }
       setID(t, r, 0, abstractID);
     }
   }
+}
 
+void Schedule::initPresentersByDemand() {
+  // Every abstract is presented once. The remaining rooms go to the abstracts
+  // with the most demand per presentation, i.e. an abstract's total rating
+  // split between its presentations.
+  struct Presentation { Score demand; ID abstractID; };
+  auto lessDemand = [](const Presentation& a, const Presentation& b) {
+    return a.demand < b.demand;
+  };
+  priority_queue<Presentation, vector<Presentation>, decltype(lessDemand)> candidates(lessDemand);
+  for (ID abstractID = 0; abstractID < m_nAbstracts; ++abstractID)
+    candidates.push(Presentation{m_maxAbstractScore[abstractID], abstractID});
+
+  const size_t nPresentations = m_nTimeslots * m_nRooms;
+  vector<s32> nPicked(m_nAbstracts, 0);
+  vector<Presentation> presentations;
+  while (presentations.size() < nPresentations && !candidates.empty()) {
+    Presentation p = candidates.top();
+    candidates.pop();
+    presentations.push_back(p);
+    s32 count = ++nPicked[p.abstractID];
+    if (count < static_cast<s32>(m_params.maxPresentations)) {
+      candidates.push(Presentation{m_maxAbstractScore[p.abstractID] / (count + 1), p.abstractID});
+    }
+  }
+  // Every abstract's first presentation goes before its repeats
+  stable_sort(presentations.begin(), presentations.end(),
+              [](const Presentation& a, const Presentation& b) { return a.demand > b.demand; });
+
+  // Spread the demand evenly: each presentation goes to the timeslot with the
+  // least demand so far which has a free room
+  vector<Score> timeslotDemand(m_nTimeslots, 0);
+  vector<s32> roomsUsed(m_nTimeslots, 0);
+  for (const Presentation& p : presentations) {
+    s32 bestTimeslot = -1;
+    for (s32 t = 0; t < m_nTimeslots; ++t) {
+      if (roomsUsed[t] >= m_nRooms || !isFreeID(t, p.abstractID) ||
+          !constraintsAllow(t, roomsUsed[t], 0, p.abstractID))
+        continue;
+      if (bestTimeslot < 0 || timeslotDemand[t] < timeslotDemand[bestTimeslot])
+        bestTimeslot = t;
+    }
+    if (bestTimeslot < 0) {
+      dbg() << "Couldn't assign abstract:" << p.abstractID << " to a timeslot" << endl;
+      continue;
+    }
+    setID(bestTimeslot, roomsUsed[bestTimeslot]++, 0, p.abstractID);
+    timeslotDemand[bestTimeslot] += p.demand;
+  }
+}
+
+void Schedule::initListenersRandom() {
   // Assign people to rooms
   for (s32 t = 0; t < m_nTimeslots; ++t) {
     for (s32 r = 0; r < m_nRooms; ++r) {
@@ -81,7 +161,118 @@ void Schedule::initState() {
   }
 }
 
+void Schedule::initListenersByFlow() {
+  // Fill timeslots one by one with an optimal assignment. People who can't
+  // reach minParticipations in the timeslots left after this one must attend.
+  vector<s32> rooms(m_nRooms);
+  for (s32 r = 0; r < m_nRooms; ++r)
+    rooms[r] = r;
+  vector<s32> freeTimeslotsLeft(m_nPeople, 0);
+  for (s32 t = 0; t < m_nTimeslots; ++t) {
+    for (ID personID = 0; personID < m_nPeople; ++personID) {
+      if (isFreeID(t, personID) && isAvailable(t, personID))
+        ++freeTimeslotsLeft[personID];
+    }
+  }
+  vector<bool> mustAttend(m_nPeople);
+  for (s32 t = 0; t < m_nTimeslots; ++t) {
+    for (ID personID = 0; personID < m_nPeople; ++personID) {
+      if (!isFreeID(t, personID) || !isAvailable(t, personID)) {
+        mustAttend[personID] = false;
+        continue;
+      }
+      --freeTimeslotsLeft[personID];
+      s32 missing = static_cast<s32>(m_params.minParticipations) - getPersonCount(personID);
+      mustAttend[personID] = missing > freeTimeslotsLeft[personID];
+    }
+    if (!assignListeners(t, rooms, mustAttend)) {
+      dbg() << "Couldn't seat all people required in timeslot:" << t << endl;
+      assignListeners(t, rooms, vector<bool>(m_nPeople, false));
+    }
+    for (s32 r = 0; r < m_nRooms; ++r) {
+      for (s32 i = 1; i < m_roomSize; ++i) {
+        if (invalidID(getID(t, r, i)))
+          dbg() << "Couldn't assign person to timeslot:" << t << " room:" << r << " seat:" << i << endl;
+      }
+    }
+  }
+}
+
+bool Schedule::assignListeners(s32 timeslot, const vector<s32>& rooms,
+                               const vector<bool>& mustAttend) {
+  // Flow network: source -> person -> room -> sink. People who must attend
+  // get a bonus bigger than the sum of all ratings in the rooms.
+  vector<ID> candidates;
+  Score maxRanking = 0;
+  for (ID personID = 0; personID < m_nPeople; ++personID) {
+    if (!isFreeID(timeslot, personID) || !isAvailable(timeslot, personID) ||
+        getPersonCount(personID) >= m_maxPersonCount[personID])
+      continue;
+    candidates.push_back(personID);
+    for (s32 r : rooms) {
+      ID abstractID = getAbstractID(timeslot, r);
+      if (validID(abstractID))
+        maxRanking = max(maxRanking, getRanking(personID, abstractID, m_params));
+    }
+  }
+  const s32 nRooms = rooms.size();
+  const Score mustAttendBonus = (nRooms * m_roomSize + 1) * (maxRanking + 1);
+
+  const s32 source = 0, sink = 1, firstPersonNode = 2;
+  const s32 firstRoomNode = firstPersonNode + candidates.size();
+  MinCostFlow flow(firstRoomNode + nRooms);
+  vector<vector<pair<s32, ID>>> roomEdges(nRooms); // (edge, personID)
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    ID personID = candidates[i];
+    flow.addEdge(source, firstPersonNode + i, 1, mustAttend[personID] ? -mustAttendBonus : 0);
+    for (s32 ri = 0; ri < nRooms; ++ri) {
+      ID abstractID = getAbstractID(timeslot, rooms[ri]);
+      if (invalidID(abstractID) || testPersonAbstract(personID, abstractID))
+        continue;
+      s32 edge = flow.addEdge(firstPersonNode + i, firstRoomNode + ri, 1,
+                              -getRanking(personID, abstractID, m_params));
+      roomEdges[ri].push_back(make_pair(edge, personID));
+    }
+  }
+  s32 nSeats = 0;
+  for (s32 ri = 0; ri < nRooms; ++ri) {
+    s32 emptySeats = 0;
+    for (s32 s = 1; s < m_roomSize; ++s) {
+      if (invalidID(getID(timeslot, rooms[ri], s)))
+        ++emptySeats;
+    }
+    flow.addEdge(firstRoomNode + ri, sink, emptySeats, 0);
+    nSeats += emptySeats;
+  }
+  s32 totalFlow;
+  flow.solve(source, sink, nSeats, true, totalFlow);
+
+  vector<bool> seated(m_nPeople, false);
+  for (s32 ri = 0; ri < nRooms; ++ri) {
+    for (auto const& x : roomEdges[ri]) {
+      if (flow.flow(x.first) > 0)
+        seated[x.second] = true;
+    }
+  }
+  for (ID personID : candidates) {
+    if (mustAttend[personID] && !seated[personID])
+      return false;
+  }
+  for (s32 ri = 0; ri < nRooms; ++ri) {
+    s32 seat = 1;
+    for (auto const& x : roomEdges[ri]) {
+      if (flow.flow(x.first) <= 0)
+        continue;
+      while (validID(getID(timeslot, rooms[ri], seat)))
+        ++seat;
+      setIDUnsafe(timeslot, rooms[ri], seat, x.second);
+    }
+  }
+  return true;
+}
+
 bool Schedule::setIDIfLegal(s32 timeslot, s32 room, s32 seat, ID newID) {
+  PROFILE_SCOPE(SetIDIfLegal);
   int i = idIndex(timeslot, room, seat);
   ID oldID = m_ids[i];
   bool newIDValid = validID(newID);
@@ -92,6 +283,8 @@ bool Schedule::setIDIfLegal(s32 timeslot, s32 room, s32 seat, ID newID) {
   }
   if (oldID == newID)
     return true;
+  if (!constraintsAllow(timeslot, room, seat, newID))
+    return false;
   if (seat == 0) {
     if (newIDValid) {
       for (s32 s = 1; s < m_roomSize; ++s) {
@@ -101,12 +294,12 @@ bool Schedule::setIDIfLegal(s32 timeslot, s32 room, s32 seat, ID newID) {
       }
     }
     if (oldIDValid) {
-      if (getAbstractCount(oldID) <= 1) {
+      if (getAbstractCount(oldID) <= m_minAbstractCount[oldID]) {
         return false;
       }
     }
     if (newIDValid) {
-      if (getAbstractCount(newID) >= static_cast<s32>(m_params.maxPresentations)) {
+      if (getAbstractCount(newID) >= m_maxAbstractCount[newID]) {
         return false;
       }
     }
@@ -116,12 +309,12 @@ bool Schedule::setIDIfLegal(s32 timeslot, s32 room, s32 seat, ID newID) {
       if (testPersonAbstractIfValid(newID, abstractID)){
         return false;
       }
-      if (getPersonCount(newID) >= static_cast<s32>(m_params.maxParticipations)) {
+      if (getPersonCount(newID) >= m_maxPersonCount[newID]) {
         return false;
       }
     }
     if (oldIDValid) {
-      if (getPersonCount(oldID) <= static_cast<s32>(m_params.minParticipations)) {
+      if (getPersonCount(oldID) <= m_minPersonCount[oldID]) {
         return false;
       }
     }
@@ -137,31 +330,67 @@ void Schedule::setIDUnsafe(s32 timeslot, s32 room, s32 seat, ID newID) {
   bool oldIDValid = validID(oldID);
   if (seat == 0) {
     if (oldIDValid) {
+      m_stats.changeAbstractCount(m_abstractCount[oldID], m_abstractCount[oldID] - 1);
       --m_abstractCount[oldID];
     }
     if (newIDValid) {
+      m_stats.changeAbstractCount(m_abstractCount[newID], m_abstractCount[newID] + 1);
       ++m_abstractCount[newID];
     }
+    if (m_params.instance->hasConstraints)
+      updateConflicts(timeslot, oldID, newID);
     for (s32 s = 1; s < m_roomSize; ++s) {
-      setPersonAbstractIfValid(getID(timeslot, room, s), oldID, false);
-      setPersonAbstractIfValid(getID(timeslot, room, s), newID, true);
+      ID personID = getID(timeslot, room, s);
+      if (invalidID(personID))
+        continue;
+      if (oldIDValid) {
+        setPersonAbstract(personID, oldID, false);
+        m_stats.changeHeard(personID, oldID, -1);
+      }
+      if (newIDValid) {
+        setPersonAbstract(personID, newID, true);
+        m_stats.changeHeard(personID, newID, 1);
+      }
     }
   } else {
     ID abstractID = getAbstractID(timeslot, room);
+    bool abstractIDValid = validID(abstractID);
     if (newIDValid) {
+      m_stats.changePersonCount(m_personCount[newID], m_personCount[newID] + 1);
       ++m_personCount[newID];
-      setPersonAbstractIfValid(newID, abstractID, true);
+      if (abstractIDValid) {
+        setPersonAbstract(newID, abstractID, true);
+        m_stats.changeHeard(newID, abstractID, 1);
+      }
     }
     if (oldIDValid) {
+      m_stats.changePersonCount(m_personCount[oldID], m_personCount[oldID] - 1);
       --m_personCount[oldID];
-      setPersonAbstractIfValid(oldID, abstractID, false);
+      if (abstractIDValid) {
+        setPersonAbstract(oldID, abstractID, false);
+        m_stats.changeHeard(oldID, abstractID, -1);
+      }
     }
   }
-  if (oldIDValid) setFreeID(timeslot, oldID, true);
-  if (newIDValid) setFreeID(timeslot, newID, false);
+  if (oldIDValid) setPersonSeat(timeslot, oldID, -1);
+  if (newIDValid) setPersonSeat(timeslot, newID, i - timeslot * m_timeslotSeats);
   m_ids[i] = newID;
 }
 
+void Schedule::updateConflicts(s32 timeslot, ID oldAbstractID, ID newAbstractID) {
+  s32* nConflicts = &m_nConflicts[timeslot * m_nAbstracts];
+  if (validID(oldAbstractID)) {
+    const boost::dynamic_bitset<>& mask = m_params.instance->conflicts[oldAbstractID];
+    for (size_t a = mask.find_first(); a != mask.npos; a = mask.find_next(a))
+      --nConflicts[a];
+  }
+  if (validID(newAbstractID)) {
+    const boost::dynamic_bitset<>& mask = m_params.instance->conflicts[newAbstractID];
+    for (size_t a = mask.find_first(); a != mask.npos; a = mask.find_next(a))
+      ++nConflicts[a];
+  }
+}
+
 bool Schedule::validate() {
   for (size_t i=0; i<m_abstractCount.size(); ++i) {
     if (m_abstractCount[i] < 1) {
@@ -179,7 +408,7 @@ void Schedule::outputRoom(ostream& s, s32 timeslot, s32 room) const {
 void Schedule::outputIDs(ostream& s, const vector<ID>& ids) const {
   for (s32 t = 0; t < m_nTimeslots; ++t) {
     for (s32 r = 0; r < m_nRooms; ++r) {
-      outputRoom(s, t, r);
+      outputRoomIDs(s, t, r, ids);
     }
   }
 }
@@ -187,7 +416,20 @@ void Schedule::outputIDs(ostream& s, const vector<ID>& ids) const {
 void Schedule::outputRoomIDs(ostream& s, s32 timeslot, s32 room, const vector<ID>& ids) const {
   for (s32 i = 0; i < m_roomSize; ++i) {
     s << (i == 0 ? "" : ",")
-      << m_params.personIdToOrig[ids.at(idIndex(timeslot, room, i))];
+      << m_params.instance->personIdToOrig[ids.at(idIndex(timeslot, room, i))];
   }
   s << endl;
 }
+
+void Schedule::outputItineraries(ostream& s) const {
+  for (ID personID = 0; personID < m_nPeople; ++personID) {
+    s << m_params.instance->personIdToOrig[personID];
+    for (s32 t = 0; t < m_nTimeslots; ++t) {
+      s << ",";
+      ID abstractID = getPersonAbstractID(t, personID);
+      if (validID(abstractID))
+        s << m_params.instance->personIdToOrig[abstractID];
+    }
+    s << endl;
+  }
+}
@@ -3,21 +3,29 @@
 #include "defs.hh"
 #include "params.hh"
 #include "utils.hh"
+#include "stats.hh"
 #include <vector>
 
 
 // Schedule class for managing a round table schedule
 class Schedule final {
 public:
-  Schedule(const Params& params) :
+  Schedule(const Options& params) :
     m_params(params), m_nPeople(params.nPeople), m_nAbstracts(params.nAbstracts),
     m_nTimeslots(params.nTimeslots), m_nRooms(params.nRooms), m_roomSize(params.roomSize),
-    m_timeslotSeats(m_nRooms * m_roomSize) { reset(); }
+    m_timeslotSeats(m_nRooms * m_roomSize), m_stats(params) { reset(); calcMaxAbstractScore(); }
   void setAllIDs(std::vector<ID> IDs);
 
   void reset();
   void initState();
 
+  // Fills the empty listener seats of the given rooms, maximizing the sum of
+  // ratings by solving a min cost flow. People flagged in mustAttend take
+  // precedence over any rating. Returns false, seating nobody, if one of
+  // them can't be seated.
+  bool assignListeners(s32 timeslot, const std::vector<s32>& rooms,
+                       const std::vector<bool>& mustAttend);
+
   ID getRandomFreePerson(s32 timeslot) {
     ID i = randInt(m_nPeople);
     for (s32 p = i; p < m_nPeople; ++p) {
@@ -54,19 +62,97 @@ public:
     (void)res;
   }
   bool setIDIfLegal(s32 timeslot, s32 room, s32 seat, ID newID);
+  // The constraints file lets the person attend the timeslot
+  bool isAvailable(s32 timeslot, ID personID) const {
+    return !m_params.instance->hasConstraints || !m_params.instance->unavailable[timeslot].test(personID);
+  }
+  // The constraints file allows the ID in the seat: they're available, and
+  // a presenter may present in the timeslot, alongside the other abstracts
+  // of the timeslot but the one in the seat. O(1).
+  bool constraintsAllow(s32 timeslot, s32 room, s32 seat, ID newID) const {
+    if (!m_params.instance->hasConstraints || invalidID(newID))
+      return true;
+    if (m_params.instance->unavailable[timeslot].test(newID))
+      return false;
+    if (seat != 0)
+      return true;
+    if (m_params.instance->cantPresent[timeslot].test(newID))
+      return false;
+    s32 nConflicts = m_nConflicts[timeslot * m_nAbstracts + newID];
+    ID oldID = getAbstractID(timeslot, room);
+    if (validID(oldID) && m_params.instance->conflicts[newID].test(oldID))
+      --nConflicts;
+    return nConflicts == 0;
+  }
   void setIDUnsafe(s32 timeslot, s32 room, s32 seat, ID newID);
   ID getID(s32 timeslot, s32 room, s32 seat) const {
     return m_ids.at(idIndex(timeslot, room, seat));
   }
   ID getAbstractID(s32 timeslot, s32 room) const { return getID(timeslot, room, 0); }
-  bool isFreeID(s32 timeslot, ID id) {
-    return m_freeIDs.at(timeslot * m_nPeople + id);
+  bool isFreeID(s32 timeslot, ID id) const {
+    return m_personSeats.at(timeslot * m_nPeople + id) < 0;
+  }
+  // Room and seat of the person in the timeslot, in O(1). False if they're
+  // free.
+  bool findPerson(s32 timeslot, ID personID, s32& room, s32& seat) const {
+    s32 index = m_personSeats.at(timeslot * m_nPeople + personID);
+    if (index < 0)
+      return false;
+    room = index / m_roomSize;
+    seat = index % m_roomSize;
+    return true;
+  }
+  // Abstract the person hears (or presents) in the timeslot, INVALID_ID if
+  // they're free
+  ID getPersonAbstractID(s32 timeslot, ID personID) const {
+    s32 room, seat;
+    return findPerson(timeslot, personID, room, seat) ? getAbstractID(timeslot, room) : INVALID_ID;
   }
   s32 getAbstractCount(ID abstractID) { return m_abstractCount[abstractID]; }
   s32 getPersonCount(ID personID) { return m_personCount[personID]; }
 
+  // Bounds checked by setIDIfLegal. Default to the participation and
+  // presentation bounds of the params.
+  s32 getMinPersonCount(ID personID) const { return m_minPersonCount[personID]; }
+  s32 getMaxPersonCount(ID personID) const { return m_maxPersonCount[personID]; }
+  void setPersonCountBounds(ID personID, s32 minCount, s32 maxCount) {
+    m_minPersonCount[personID] = minCount;
+    m_maxPersonCount[personID] = maxCount;
+  }
+  void setAbstractCountBounds(ID abstractID, s32 minCount, s32 maxCount) {
+    m_minAbstractCount[abstractID] = minCount;
+    m_maxAbstractCount[abstractID] = maxCount;
+  }
+  // Lets every count range over all timeslots, for searches penalizing the
+  // bounds instead, until restoreCountBounds() (or reset())
+  void relaxCountBounds() {
+    m_strictMinPersonCount = m_minPersonCount;
+    m_strictMaxPersonCount = m_maxPersonCount;
+    m_strictMinAbstractCount = m_minAbstractCount;
+    m_strictMaxAbstractCount = m_maxAbstractCount;
+    m_minPersonCount.assign(m_nPeople, 0);
+    m_maxPersonCount.assign(m_nPeople, m_nTimeslots);
+    m_minAbstractCount.assign(m_nAbstracts, 0);
+    m_maxAbstractCount.assign(m_nAbstracts, m_nTimeslots);
+  }
+  // The bounds before relaxCountBounds()
+  void restoreCountBounds() {
+    m_minPersonCount = m_strictMinPersonCount;
+    m_maxPersonCount = m_strictMaxPersonCount;
+    m_minAbstractCount = m_strictMinAbstractCount;
+    m_maxAbstractCount = m_strictMaxAbstractCount;
+  }
+  // Forbids seating the person in rooms presenting the abstract, as if they
+  // already heard it. Cleared by reset().
+  void blockPersonAbstract(ID personID, ID abstractID) {
+    ASSERT(!testPersonAbstract(personID, abstractID));
+    setPersonAbstract(personID, abstractID, true);
+  }
+
   bool validate();
 
+  const ScheduleStats& stats() const { return m_stats; }
+
   void getAllIDs(std::vector<ID>& ids) const { ids = m_ids; }
   void output(std::ostream& s) const { outputIDs(s, m_ids); }
   void outputRoom(std::ostream& s, s32 timeslot, s32 room) const;
@@ -75,10 +161,21 @@ public:
 
   void outputRoomIDs(std::ostream& s, s32 timeslot, s32 room, const std::vector<ID>& ids) const;
 
+  // One row per person: their ID, then the abstract they hear (their own
+  // while presenting) in each timeslot, empty when free
+  void outputItineraries(std::ostream& s) const;
+
 protected:
 
-  void setFreeID(s32 timeslot, ID id, bool val) {
-    m_freeIDs[timeslot * m_nPeople + id] = val;
+  void calcMaxAbstractScore();
+  void updateConflicts(s32 timeslot, ID oldAbstractID, ID newAbstractID);
+  void initPresenters();
+  void initPresentersByDemand();
+  void initListenersRandom();
+  void initListenersByFlow();
+
+  void setPersonSeat(s32 timeslot, ID id, s32 index) {
+    m_personSeats[timeslot * m_nPeople + id] = index;
   }
   int idIndex(s32 timeslot, s32 room, s32 seat) const {
     return timeslot * m_timeslotSeats +
@@ -86,14 +183,23 @@ protected:
            seat;
   }
 
-  const Params& m_params;
+  const Options& m_params;
   const s32 m_nPeople, m_nAbstracts;
   const s32 m_nTimeslots, m_nRooms, m_roomSize, m_timeslotSeats;
   std::vector<ID> m_ids;
-  std::vector<bool> m_freeIDs;
+  std::vector<s32> m_personSeats; // (timeslot, person) -> room * roomSize + seat, -1 if free
   std::vector<Score> m_maxAbstractScore;
   std::vector<s32> m_abstractCount;
   std::vector<s32> m_personCount;
+  std::vector<s32> m_minPersonCount, m_maxPersonCount;
+  std::vector<s32> m_minAbstractCount, m_maxAbstractCount;
+  // Saved by relaxCountBounds()
+  std::vector<s32> m_strictMinPersonCount, m_strictMaxPersonCount;
+  std::vector<s32> m_strictMinAbstractCount, m_strictMaxAbstractCount;
 
   std::vector<s8> m_personAbstract;
+  // (timeslot, abstract) -> abstracts presented in the timeslot which
+  // conflict with it, kept if there are constraints
+  std::vector<s32> m_nConflicts;
+  ScheduleStats m_stats;
 };
@@ -1,5 +1,8 @@
 #include "scorer.hh"
+#include "bound.hh"
+#include "profile.hh"
 #include <algorithm>
+#include <cmath>
 
 Score SumHappinessScorer::calcRoomScore(s32 timeslot, s32 room) {
   Score score = 0;
@@ -21,6 +24,7 @@ Score SumHappinessScorer::calcScore() {
 }
 
 void SumHappinessScorer::prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) {
+  PROFILE_SCOPE(ScorerPrepare);
   m_preChangePartialScore = 0;
   m_useChange2 = false;
   prepareSetChangeImpl(m_change1, timeslot, room);
@@ -29,6 +33,7 @@ void SumHappinessScorer::prepareSetChange(s32 timeslot, s32 room, s32 seat, ID i
 void SumHappinessScorer::prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
                                s32 timeslot2, s32 room2, s32 seat2)
 {
+  PROFILE_SCOPE(ScorerPrepare);
   m_preChangePartialScore = 0;
   prepareSetChangeImpl(m_change1, timeslot1, room1);
   m_useChange2 = timeslot1 != timeslot2 || room1 != room2;
@@ -38,22 +43,29 @@ void SumHappinessScorer::prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
 }
 
 void SumHappinessScorer::tryChange() {
+  PROFILE_SCOPE(ScorerTry);
   Score newScore = calcRoomScore(m_change1.timeslot, m_change1.room);
   if (m_useChange2) {
     newScore += calcRoomScore(m_change2.timeslot, m_change2.room);
   }
-  m_changeScoreDelta = newScore - m_preChangePartialScore;
-  m_score += m_changeScoreDelta;
+  m_preChangeScore = m_score;
+  m_score += newScore - m_preChangePartialScore;
 }
 
 void SumHappinessScorer::undoChange() {
-  m_score -= m_changeScoreDelta;
+  PROFILE_SCOPE(ScorerUndo);
+  // Restore exactly, so evaluating a move leaves no rounding behind
+  m_score = m_preChangeScore;
+}
+
+Score SumHappinessScorer::upperBound() {
+  return sharedAssignmentBound(m_params);
 }
 
 Score SumHappinessScorer::singleScore(ID abstractID, ID personID) {
   if (invalidID(abstractID) || invalidID(personID))
     return 0;
-  return getRanking(personID, abstractID, m_params);
+  return getRanking(personID, abstractID, m_rankings, m_params.nPeople);
 }
 
 Score SumHappinessScorer::calcSingleScore(s32 timeslot, s32 room, s32 seat) {
@@ -65,8 +77,8 @@ void SumHappinessScorer::prepareSetChangeImpl(possibleChange& change, s32 timesl
   m_preChangePartialScore += calcRoomScore(timeslot, room);
 }
 
-MinHappinessBonusScorer::MinHappinessBonusScorer(Schedule& sched, const Params& params) :
-  m_sched(sched), m_params(params),
+MinHappinessBonusScorer::MinHappinessBonusScorer(Schedule& sched, const Options& params) :
+  m_sched(sched), m_params(params), m_rankings(m_params.instance->rankings),
   m_pointBonus(100 * params.maxNormScore * params.nRooms * params.roomSize) {
     dbg() << "Point bonus: " << m_pointBonus << endl;
     calcScorePerPerson();
@@ -83,6 +95,42 @@ Score MinHappinessBonusScorer::calcScore() {
   return minScore * m_pointBonus;
 }
 
+void MinHappinessBonusScorer::tryChange() {
+  PROFILE_SCOPE(ScorerTry);
+  recalcScore();
+}
+
+void MinHappinessBonusScorer::undoChange() {
+  PROFILE_SCOPE(ScorerUndo);
+  recalcScore();
+}
+
+Score MinHappinessBonusScorer::upperBound() {
+  // Nobody's score is above their maxParticipations best ratings
+  Score minRatio = numeric_limits<Score>::infinity();
+  vector<Score> personScores;
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    if (m_maxScorePerPerson[personID] <= 0)
+      continue;
+    personScores.clear();
+    for (ID abstractID = 0; abstractID < m_params.nAbstracts; ++abstractID)
+      personScores.push_back(getRanking(personID, abstractID, m_params));
+    sort(begin(personScores), end(personScores), std::greater<Score>());
+    Score sumScore = 0;
+    for (u32 i = 0; i < m_params.maxParticipations && i < personScores.size(); ++i)
+      sumScore += personScores[i];
+    minRatio = min(minRatio, sumScore / m_maxScorePerPerson[personID]);
+  }
+  return minRatio * m_pointBonus;
+}
+
+bool MinHappinessBonusScorer::personSatisfaction(vector<Score>& satisfaction) {
+  satisfaction.resize(m_scorePerPerson.size());
+  for (size_t i = 0; i < m_scorePerPerson.size(); ++i)
+    satisfaction[i] = personRatio(i);
+  return true;
+}
+
 ID MinHappinessBonusScorer::calcMinPersonScoreID() {
   Score minScore;
   int nPeople;
@@ -91,11 +139,20 @@ ID MinHappinessBonusScorer::calcMinPersonScoreID() {
   return firstPersonID;
 }
 
+Score MinHappinessBonusScorer::calcMinPersonScore() {
+  Score minScore;
+  int nPeople;
+  ID firstPersonID;
+  findMinPersonScore(minScore, nPeople, firstPersonID);
+  return minScore;
+}
+
 void MinHappinessBonusScorer::addScorePerPersonForRoom(s32 timeslot, s32 room) {
   ID abstractID = m_sched.getAbstractID(timeslot, room);
   for (int i=1; i < m_params.roomSize; ++i) {
     ID personID = m_sched.getID(timeslot, room, i);
-    m_scorePerPerson[personID] += singleScore(abstractID, personID);
+    if (validID(personID))
+      m_scorePerPerson[personID] += singleScore(abstractID, personID);
   }
 }
 
@@ -116,10 +173,10 @@ void MinHappinessBonusScorer::calcMaxScorePerPerson() {
       sumScore += personScores[i];
     }
     m_maxScorePerPerson.push_back(sumScore);
-    dbg() << "ID:" << personID << " (orig:" << m_params.personIdToOrig[personID]
+    dbg() << "ID:" << personID << " (orig:" << m_params.instance->personIdToOrig[personID]
           << ") max: " << sumScore << " current:" << m_scorePerPerson[personID]
-          << " ratio:" << (m_scorePerPerson[personID] / sumScore)
-          << " bonus:" << ((m_scorePerPerson[personID] / sumScore) * m_pointBonus)
+          << " ratio:" << personRatio(personID)
+          << " bonus:" << (personRatio(personID) * m_pointBonus)
           << endl;
   }
 }
@@ -138,7 +195,7 @@ void MinHappinessBonusScorer::findMinPersonScore(Score& minScore, int& nPeople,
   nPeople = 0;
   firstPersonID = INVALID_ID;
   for (ID i=0; i < static_cast<ID>(m_scorePerPerson.size()); ++i) {
-    Score normalizedScore = m_scorePerPerson[i] / m_maxScorePerPerson[i];
+    Score normalizedScore = personRatio(i);
     if (normalizedScore < minScore) {
       minScore = normalizedScore;
       firstPersonID = i;
@@ -152,9 +209,217 @@ void MinHappinessBonusScorer::findMinPersonScore(Score& minScore, int& nPeople,
 Score MinHappinessBonusScorer::singleScore(ID abstractID, ID personID) {
   if (invalidID(abstractID) || invalidID(personID))
     return 0;
-  return getRanking(personID, abstractID, m_params);
+  return getRanking(personID, abstractID, m_rankings, m_params.nPeople);
 }
 
 Score MinHappinessBonusScorer::calcSingleScore(s32 timeslot, s32 room, s32 seat) {
   return singleScore(m_sched.getAbstractID(timeslot, room), m_sched.getID(timeslot, room, seat));
 }
+
+ConcaveFairnessScorer::ConcaveFairnessScorer(Schedule& sched, const Options& params,
+                                             const string& utility) :
+  m_sched(sched), m_params(params), m_rankings(m_params.instance->rankings),
+  m_sqrt(utility == "sqrt") {
+  // The best score of the minimum participations, as for the min bonus
+  vector<Score> personScores;
+  Score sumMax = 0;
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    personScores.clear();
+    for (ID abstractID = 0; abstractID < m_params.nAbstracts; ++abstractID)
+      personScores.push_back(getRanking(personID, abstractID, m_params));
+    sort(begin(personScores), end(personScores), std::greater<Score>());
+    Score sumScore = 0;
+    for (u32 i = 0; i < m_params.minParticipations && i < personScores.size(); ++i)
+      sumScore += personScores[i];
+    m_maxScorePerPerson.push_back(sumScore);
+    sumMax += sumScore;
+  }
+  m_scale = m_params.nPeople > 0 ? sumMax / m_params.nPeople : 0;
+  recalcScore();
+}
+
+Score ConcaveFairnessScorer::utility(ID personID, Score personScore) const {
+  if (m_maxScorePerPerson[personID] <= 0)
+    return 0;
+  Score ratio = max(Score(0), personScore / m_maxScorePerPerson[personID]);
+  if (m_sqrt)
+    return m_scale * sqrt(ratio);
+  // Rescaled so that 0 and 1 keep their utility, steep near 0
+  const Score eps = 0.05;
+  return m_scale * log1p(ratio / eps) / log1p(1 / eps);
+}
+
+Score ConcaveFairnessScorer::calcScore() {
+  m_scorePerPerson.assign(m_params.nPeople, 0);
+  for (s32 t = 0; t < m_params.nTimeslots; ++t) {
+    for (s32 r = 0; r < m_params.nRooms; ++r) {
+      ID abstractID = m_sched.getAbstractID(t, r);
+      if (invalidID(abstractID))
+        continue;
+      for (s32 s = 1; s < m_params.roomSize; ++s) {
+        ID personID = m_sched.getID(t, r, s);
+        if (validID(personID))
+          m_scorePerPerson[personID] += getRanking(personID, abstractID, m_rankings,
+                                                   m_params.nPeople);
+      }
+    }
+  }
+  Score score = 0;
+  for (ID personID = 0; personID < m_params.nPeople; ++personID)
+    score += utility(personID, m_scorePerPerson[personID]);
+  return score;
+}
+
+void ConcaveFairnessScorer::addChangedSeats(s32 timeslot, s32 room, s32 seat) {
+  for (const Seat& changed : m_changedSeats) {
+    // Already covered by a change of the room's presenter or of the seat
+    if (changed.timeslot == timeslot && changed.room == room &&
+        (changed.seat == 0 || changed.seat == seat))
+      return;
+  }
+  if (seat != 0) {
+    m_changedSeats.push_back(Seat{timeslot, room, seat});
+    return;
+  }
+  // A listener of the room is covered by the presenter's change
+  m_changedSeats.erase(remove_if(begin(m_changedSeats), end(m_changedSeats),
+    [&](const Seat& s) { return s.timeslot == timeslot && s.room == room; }),
+    end(m_changedSeats));
+  for (s32 s = 1; s < m_params.roomSize; ++s)
+    m_changedSeats.push_back(Seat{timeslot, room, s});
+}
+
+Score ConcaveFairnessScorer::seatRating(const Seat& seat, ID& personID) const {
+  personID = m_sched.getID(seat.timeslot, seat.room, seat.seat);
+  ID abstractID = m_sched.getAbstractID(seat.timeslot, seat.room);
+  if (invalidID(personID) || invalidID(abstractID))
+    return 0;
+  return getRanking(personID, abstractID, m_rankings, m_params.nPeople);
+}
+
+void ConcaveFairnessScorer::prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) {
+  prepareSwapChange(timeslot, room, seat, timeslot, room, seat);
+}
+
+void ConcaveFairnessScorer::prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
+                                              s32 timeslot2, s32 room2, s32 seat2) {
+  PROFILE_SCOPE(ScorerPrepare);
+  m_changedSeats.clear();
+  addChangedSeats(timeslot1, room1, seat1);
+  addChangedSeats(timeslot2, room2, seat2);
+  m_preChangeRatings.clear();
+  for (const Seat& seat : m_changedSeats) {
+    ID personID;
+    Score rating = seatRating(seat, personID);
+    m_preChangeRatings.emplace_back(personID, rating);
+  }
+}
+
+void ConcaveFairnessScorer::addPersonScore(ID personID, Score delta) {
+  if (invalidID(personID) || delta == 0)
+    return;
+  Score& personScore = m_scorePerPerson[personID];
+  m_undoLog.emplace_back(personID, personScore);
+  m_score -= utility(personID, personScore);
+  personScore += delta;
+  m_score += utility(personID, personScore);
+}
+
+void ConcaveFairnessScorer::tryChange() {
+  PROFILE_SCOPE(ScorerTry);
+  m_preChangeScore = m_score;
+  m_undoLog.clear();
+  for (size_t i = 0; i < m_changedSeats.size(); ++i) {
+    ID personID;
+    Score rating = seatRating(m_changedSeats[i], personID);
+    addPersonScore(m_preChangeRatings[i].first, -m_preChangeRatings[i].second);
+    addPersonScore(personID, rating);
+  }
+}
+
+void ConcaveFairnessScorer::undoChange() {
+  PROFILE_SCOPE(ScorerUndo);
+  for (auto it = m_undoLog.rbegin(); it != m_undoLog.rend(); ++it)
+    m_scorePerPerson[it->first] = it->second;
+  m_undoLog.clear();
+  m_score = m_preChangeScore;
+}
+
+Score ConcaveFairnessScorer::upperBound() {
+  // Nobody's score is above their maxParticipations best ratings, and the
+  // utility only grows with it
+  Score bound = 0;
+  vector<Score> personScores;
+  for (ID personID = 0; personID < m_params.nPeople; ++personID) {
+    personScores.clear();
+    for (ID abstractID = 0; abstractID < m_params.nAbstracts; ++abstractID)
+      personScores.push_back(getRanking(personID, abstractID, m_params));
+    sort(begin(personScores), end(personScores), std::greater<Score>());
+    Score sumScore = 0;
+    for (u32 i = 0; i < m_params.maxParticipations && i < personScores.size(); ++i)
+      sumScore += personScores[i];
+    bound += utility(personID, sumScore);
+  }
+  return bound;
+}
+
+bool ConcaveFairnessScorer::personSatisfaction(vector<Score>& satisfaction) {
+  satisfaction.resize(m_scorePerPerson.size());
+  for (size_t i = 0; i < m_scorePerPerson.size(); ++i)
+    satisfaction[i] = m_maxScorePerPerson[i] > 0 ? m_scorePerPerson[i] / m_maxScorePerPerson[i] : 1;
+  return true;
+}
+
+Score BoundsPenaltyScorer::calcScore() {
+  m_violations = 0;
+  for (ID id = 0; id < m_params.nPeople; ++id)
+    m_violations += idViolations(id);
+  return -m_weight * m_violations;
+}
+
+void BoundsPenaltyScorer::setPenaltyWeight(double weight) {
+  m_weight = weight;
+  m_score = -m_weight * m_violations;
+}
+
+s32 BoundsPenaltyScorer::idViolations(ID id) {
+  if (invalidID(id))
+    return 0;
+  s32 count = m_sched.getPersonCount(id);
+  s32 res = max(0, s32(m_params.minParticipations) - count) +
+            max(0, count - s32(m_params.maxParticipations));
+  if (id < m_params.nAbstracts) {
+    count = m_sched.getAbstractCount(id);
+    res += max(0, 1 - count) + max(0, count - s32(m_params.maxPresentations));
+  }
+  return res;
+}
+
+void BoundsPenaltyScorer::prepareChange(ID id1, ID id2) {
+  m_changedIDs[0] = id1;
+  m_changedIDs[1] = (id2 == id1) ? INVALID_ID : id2;
+  m_preChangeViolations = m_violations;
+  m_preChangeIDViolations = idViolations(m_changedIDs[0]) + idViolations(m_changedIDs[1]);
+}
+
+void BoundsPenaltyScorer::prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) {
+  prepareChange(m_sched.getID(timeslot, room, seat), id);
+}
+
+void BoundsPenaltyScorer::prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
+                                            s32 timeslot2, s32 room2, s32 seat2) {
+  prepareChange(m_sched.getID(timeslot1, room1, seat1), m_sched.getID(timeslot2, room2, seat2));
+}
+
+void BoundsPenaltyScorer::tryChange() {
+  PROFILE_SCOPE(ScorerTry);
+  m_violations += idViolations(m_changedIDs[0]) + idViolations(m_changedIDs[1]) -
+                  m_preChangeIDViolations;
+  m_score = -m_weight * m_violations;
+}
+
+void BoundsPenaltyScorer::undoChange() {
+  PROFILE_SCOPE(ScorerUndo);
+  m_violations = m_preChangeViolations;
+  m_score = -m_weight * m_violations;
+}
@@ -3,15 +3,18 @@
 #include "params.hh"
 #include "utils.hh"
 #include "schedule.hh"
+#include <limits>
+#include <memory>
 
 using namespace std;
 
 class Scorer {
 public:
   Scorer() = default;
+  virtual ~Scorer() = default;
 
   Score score() { return m_score; }
-  void recalcScore() { m_score = calcScore(); }
+  virtual void recalcScore() { m_score = calcScore(); }
 
   virtual Score calcRoomScore(s32 timeslot, s32 room) = 0;
   virtual Score calcScore() = 0;
@@ -20,6 +23,16 @@ public:
                                  s32 timeslot2, s32 room2, s32 seat2) = 0;
   virtual void tryChange() = 0;
   virtual void undoChange() = 0;
+
+  // No schedule can score above this
+  virtual Score upperBound() { return numeric_limits<Score>::infinity(); }
+  // Each person's score as a fraction of their best possible one, for
+  // scorers of fairness. False if the scorer doesn't track it.
+  virtual bool personSatisfaction(vector<Score>& satisfaction) { return false; }
+  // Participation and presentation bound violations of the schedule, for
+  // scorers penalizing them (soft bounds), and the penalty per violation
+  virtual s32 boundViolations() { return 0; }
+  virtual void setPenaltyWeight(double weight) {}
 protected:
   Score m_score;
 };
@@ -27,8 +40,8 @@ protected:
 
 class SumHappinessScorer final : public Scorer {
 public:
-  SumHappinessScorer(Schedule& sched, const Params& params) :
-    m_sched(sched), m_params(params) { recalcScore(); };
+  SumHappinessScorer(Schedule& sched, const Options& params) :
+    m_sched(sched), m_params(params), m_rankings(m_params.instance->rankings) { recalcScore(); };
 
   virtual Score calcRoomScore(s32 timeslot, s32 room) override;
 
@@ -43,13 +56,16 @@ public:
 
   virtual void undoChange() override;
 
+  virtual Score upperBound() override;
+
 protected:
   Schedule& m_sched;
-  const Params m_params;
+  const Options m_params;
+  const Rankings& m_rankings; // Of the shared instance, read without indirection
 
   struct possibleChange { s32 timeslot, room; };
   possibleChange m_change1, m_change2;
-  Score m_preChangePartialScore, m_changeScoreDelta;
+  Score m_preChangePartialScore, m_preChangeScore;
   bool m_useChange2;
 
   Score singleScore(ID abstractID, ID personID);
@@ -60,7 +76,7 @@ protected:
 
 class MinHappinessBonusScorer final : public Scorer {
 public:
-  MinHappinessBonusScorer(Schedule& sched, const Params& params);
+  MinHappinessBonusScorer(Schedule& sched, const Options& params);
 
   virtual Score calcScore() override;
 
@@ -73,15 +89,22 @@ public:
   virtual void prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
                                  s32 timeslot2, s32 room2, s32 seat2) override { }
 
-  virtual void tryChange() override { recalcScore(); }
+  virtual void tryChange() override;
+
+  virtual void undoChange() override;
+
+  virtual Score upperBound() override;
 
-  virtual void undoChange() override { recalcScore(); }
+  virtual bool personSatisfaction(vector<Score>& satisfaction) override;
 
   ID calcMinPersonScoreID();
+  // The least satisfied person's score, as a fraction of their best possible
+  Score calcMinPersonScore();
 
 protected:
   Schedule& m_sched;
-  const Params m_params;
+  const Options m_params;
+  const Rankings& m_rankings;
 
   const Score m_pointBonus;
 
@@ -92,16 +115,103 @@ protected:
   void calcMaxScorePerPerson();
   void calcScorePerPerson();
   void findMinPersonScore(Score& minScore, int& nPeople, ID& firstPersonID);
+  // Fraction of the person's best score, 1 for people without ratings
+  Score personRatio(ID personID) const {
+    Score maxScore = m_maxScorePerPerson[personID];
+    return maxScore > 0 ? m_scorePerPerson[personID] / maxScore : 1;
+  }
   Score singleScore(ID abstractID, ID personID);
   Score calcSingleScore(s32 timeslot, s32 room, s32 seat);
 };
 
+// The sum over people of a concave utility (log or sqrt) of their score as a
+// fraction of their best possible one, scaled to the average best score.
+// Raising a less satisfied person's score gains more, so fairness gets a
+// gradient everywhere instead of only at the minimum. Each person's score is
+// kept, so a listener change rescores one person and a presenter change the
+// listeners of the room.
+class ConcaveFairnessScorer final : public Scorer {
+public:
+  ConcaveFairnessScorer(Schedule& sched, const Options& params, const std::string& utility);
+
+  virtual Score calcRoomScore(s32 timeslot, s32 room) override { return 0; }
+  virtual Score calcScore() override;
+  virtual void prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) override;
+  virtual void prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
+                                 s32 timeslot2, s32 room2, s32 seat2) override;
+  virtual void tryChange() override;
+  virtual void undoChange() override;
+  virtual Score upperBound() override;
+  virtual bool personSatisfaction(vector<Score>& satisfaction) override;
+
+protected:
+  Schedule& m_sched;
+  const Options m_params;
+  const Rankings& m_rankings;
+  const bool m_sqrt;
+  Score m_scale; // Average best score
+
+  vector<Score> m_scorePerPerson;
+  vector<Score> m_maxScorePerPerson;
+
+  // Seats whose rating changes with the prepared change, and their
+  // (person, rating) before it
+  struct Seat { s32 timeslot, room, seat; };
+  vector<Seat> m_changedSeats;
+  vector<pair<ID, Score>> m_preChangeRatings;
+  // (person, score) before each update of tryChange, undone in reverse
+  vector<pair<ID, Score>> m_undoLog;
+  Score m_preChangeScore;
+
+  Score utility(ID personID, Score personScore) const;
+  void addChangedSeats(s32 timeslot, s32 room, s32 seat);
+  void addPersonScore(ID personID, Score delta);
+  Score seatRating(const Seat& seat, ID& personID) const;
+};
+
+// Minus the weighted distance of every participation and presentation count
+// to its bounds (of the params), for searches with the bounds relaxed. Reads
+// the counts the schedule keeps, so a change only rescores the two IDs it
+// moves.
+class BoundsPenaltyScorer final : public Scorer {
+public:
+  BoundsPenaltyScorer(Schedule& sched, const Options& params) :
+    m_sched(sched), m_params(params), m_weight(1) { recalcScore(); }
+
+  virtual Score calcRoomScore(s32 timeslot, s32 room) override { return 0; }
+  virtual Score calcScore() override;
+  virtual void prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) override;
+  virtual void prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
+                                 s32 timeslot2, s32 room2, s32 seat2) override;
+  virtual void tryChange() override;
+  virtual void undoChange() override;
+  virtual Score upperBound() override { return 0; }
+  virtual s32 boundViolations() override { return m_violations; }
+  virtual void setPenaltyWeight(double weight) override;
+
+protected:
+  Schedule& m_sched;
+  const Options m_params;
+  double m_weight;
+  s32 m_violations;
+  ID m_changedIDs[2];
+  s32 m_preChangeViolations, m_preChangeIDViolations;
+
+  // As a listener and, for presenters, as an abstract
+  s32 idViolations(ID id);
+  void prepareChange(ID id1, ID id2);
+};
+
 class SumScorers final : public Scorer {
 public:
   SumScorers(Scorer& scorer1, Scorer& scorer2) :
     m_scorer1(scorer1), m_scorer2(scorer2) { recalcScore(); }
+  // Owns the summed scorers
+  SumScorers(unique_ptr<Scorer> scorer1, unique_ptr<Scorer> scorer2) :
+    m_owned1(move(scorer1)), m_owned2(move(scorer2)),
+    m_scorer1(*m_owned1), m_scorer2(*m_owned2) { recalcScore(); }
 
-  void recalcScore() {
+  virtual void recalcScore() override {
     m_scorer1.recalcScore();
     m_scorer2.recalcScore();
     m_score = score();
@@ -137,8 +247,70 @@ public:
     m_scorer2.undoChange();
     m_score = score();
   }
+  virtual Score upperBound() {
+    return m_scorer1.upperBound() + m_scorer2.upperBound();
+  }
+  virtual bool personSatisfaction(vector<Score>& satisfaction) override {
+    return m_scorer1.personSatisfaction(satisfaction) ||
+           m_scorer2.personSatisfaction(satisfaction);
+  }
+  virtual s32 boundViolations() override {
+    return m_scorer1.boundViolations() + m_scorer2.boundViolations();
+  }
+  virtual void setPenaltyWeight(double weight) override {
+    m_scorer1.setPenaltyWeight(weight);
+    m_scorer2.setPenaltyWeight(weight);
+  }
 
 protected:
+  unique_ptr<Scorer> m_owned1, m_owned2;
   Scorer &m_scorer1;
   Scorer &m_scorer2;
 };
+
+// Another scorer's score multiplied by a constant weight
+class ScaledScorer final : public Scorer {
+public:
+  ScaledScorer(unique_ptr<Scorer> scorer, double weight) :
+    m_scorer(move(scorer)), m_weight(weight) { recalcScore(); }
+
+  virtual void recalcScore() override {
+    m_scorer->recalcScore();
+    m_score = m_weight * m_scorer->score();
+  }
+  virtual Score calcRoomScore(s32 timeslot, s32 room) override {
+    return m_weight * m_scorer->calcRoomScore(timeslot, room);
+  }
+  virtual Score calcScore() override {
+    return m_weight * m_scorer->calcScore();
+  }
+  virtual void prepareSetChange(s32 timeslot, s32 room, s32 seat, ID id) override {
+    m_scorer->prepareSetChange(timeslot, room, seat, id);
+    m_score = m_weight * m_scorer->score();
+  }
+  virtual void prepareSwapChange(s32 timeslot1, s32 room1, s32 seat1,
+                                 s32 timeslot2, s32 room2, s32 seat2) override {
+    m_scorer->prepareSwapChange(timeslot1, room1, seat1, timeslot2, room2, seat2);
+    m_score = m_weight * m_scorer->score();
+  }
+  virtual void tryChange() override {
+    m_scorer->tryChange();
+    m_score = m_weight * m_scorer->score();
+  }
+  virtual void undoChange() override {
+    m_scorer->undoChange();
+    m_score = m_weight * m_scorer->score();
+  }
+  virtual Score upperBound() override {
+    return m_weight * m_scorer->upperBound();
+  }
+  virtual bool personSatisfaction(vector<Score>& satisfaction) override {
+    return m_scorer->personSatisfaction(satisfaction);
+  }
+  virtual s32 boundViolations() override { return m_scorer->boundViolations(); }
+  virtual void setPenaltyWeight(double weight) override { m_scorer->setPenaltyWeight(weight); }
+
+protected:
+  unique_ptr<Scorer> m_scorer;
+  const double m_weight;
+};
@@ -0,0 +1,58 @@
+#include "solver.hh"
+#include "elite.hh"
+#include "pipeline.hh"
+#include "scorer.hh"
+#include "utils.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+bool setRatings(Params& params, const vector<Rating>& ratings) {
+  shared_ptr<Instance> inst = editInstance(params);
+  inst->origRankings.clear();
+  inst->unrankedPersonIDs.clear();
+  inst->unrankedAbstractIDs.clear();
+  for (const Rating& rating : ratings) {
+    Score score = min(max(rating.score, params.minScore), params.maxScore);
+    addRating(*inst, rating.personID, rating.abstractID, score + params.scoreDelta);
+  }
+  if (!prepareRankings(params))
+    return false;
+  calcParticipationBounds(params);
+  return true;
+}
+
+Solver::Solver(const Params& params) : m_params(params), m_cancelled(false) {
+  if (m_params.phases.empty())
+    m_params.phases = defaultPhases(m_params);
+  m_params.cancel = &m_cancelled;
+  randSetSeed(m_params.seed);
+  m_sched.reset(new Schedule(m_params));
+  m_sched->initState();
+}
+
+bool Solver::run(u64 iterations, double seconds) {
+  bool ok = runRestarts(*m_sched, withBudget(m_params, iterations, seconds));
+  m_cancelled = false;
+  return ok;
+}
+
+vector<ID> Solver::bestIDs() const {
+  vector<ID> ids;
+  m_sched->getAllIDs(ids);
+  for (ID& id : ids) {
+    if (validID(id))
+      id = m_params.instance->personIdToOrig[id];
+  }
+  return ids;
+}
+
+Score Solver::score() const {
+  return SumHappinessScorer(*m_sched, m_params).score();
+}
+
+Score Solver::minHappiness() const {
+  return MinHappinessBonusScorer(*m_sched, m_params).calcMinPersonScore();
+}
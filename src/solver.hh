@@ -0,0 +1,59 @@
+#pragma once
+
+#include "params.hh"
+#include "schedule.hh"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+// In-process interface of libalpine_scheduler, for programs embedding the
+// scheduler instead of running the command line tool. Typical use:
+//   Params params = defaultParams();
+//   params.resultsDir = "";  // Keep the results in memory only
+//   setRatings(params, ratings);
+//   Solver solver(params);
+//   solver.run(0, 10);       // Phases of up to 10 seconds each
+//   std::vector<ID> ids = solver.bestIDs();
+
+// A rating in original IDs, with the score as in the input file. An
+// INVALID_ID abstract (person) adds a person (abstract) without ratings.
+struct Rating {
+  ID personID, abstractID;
+  Score score;
+};
+
+// Replaces the ratings, clamping the scores like the input file, and
+// prepares everything derived from them and the event's shape
+bool setRatings(Params& params, const std::vector<Rating>& ratings);
+
+// Owns a schedule of the params' event and improves it with the phases
+// pipeline, keeping it between runs
+class Solver final {
+public:
+  // Builds the initial schedule. Uses the default phases if none are set.
+  explicit Solver(const Params& params);
+
+  // Runs the phases from the current schedule, with the given budget per
+  // phase (0 keeps the phases' own), and the restarts if any. Leaves the
+  // best schedule found.
+  bool run(u64 iterations = 0, double seconds = 0);
+  // Stops the current run from any thread, keeping its best schedule.
+  // Stops the next run right away if none is running.
+  void cancel() { m_cancelled = true; }
+
+  const Params& params() const { return m_params; }
+  const Schedule& schedule() const { return *m_sched; }
+  // Original IDs by timeslot, room and seat, the presenter first
+  std::vector<ID> bestIDs() const;
+  // Sum of the normalized ratings of the schedule
+  Score score() const;
+  // The least satisfied person's score, as a fraction of their best
+  Score minHappiness() const;
+
+protected:
+  Params m_params;
+  std::unique_ptr<Schedule> m_sched;
+  std::atomic<bool> m_cancelled;
+};
@@ -0,0 +1,107 @@
+#include "speculative.hh"
+#include "annealing.hh"
+#include "workers.hh"
+
+#include <iomanip>
+#include <math.h>
+
+using namespace std;
+
+
+bool SpeculativeAnnealing::run() {
+  m_startTime = chrono::system_clock::now();
+  // Start all replicas from identically computed scores, evaluating a move
+  // on any of them then gives bit identical deltas
+  m_scorer.recalcScore();
+  m_bestScore = m_scorer.score();
+  handleNewBest();
+
+  WorkerPool pool(max(1, m_params.threads));
+  const s32 nWorkers = pool.size();
+  // Worker 0 evaluates on the schedule itself, the others on replicas
+  vector<unique_ptr<Schedule>> scheds;
+  vector<unique_ptr<Scorer>> scorers;
+  for (s32 w = 1; w < nWorkers; ++w) {
+    scheds.emplace_back(new Schedule(m_sched));
+    scorers.push_back(m_scorerFactory(*scheds.back()));
+  }
+
+  const s32 batchSize = max(1, m_params.speculativeBatch);
+  vector<Proposal> batch(batchSize);
+  Move accepted;
+  bool hasAccepted = false;
+  double nextOutputSec = 0;
+  u64 nextTemperatureIter = 0;
+  for (m_iter = 0; m_iter < m_params.maxIterations;) {
+    if (m_iter >= nextTemperatureIter) {
+      m_temperature = annealingTemperature(m_params, m_iter);
+      nextTemperatureIter += 10000;
+      if (elapsedSecs(m_startTime) >= nextOutputSec) {
+        if (!outputStatus(dbg()))
+          return false;
+        nextOutputSec += m_params.progressSeconds;
+      }
+      if (reachedStopCondition()) {
+        restoreBest();
+        break;
+      }
+    }
+    for (Proposal& p : batch) {
+      p.legal = proposeMove(p.move);
+      p.prob = randProb();
+    }
+
+    pool.run([&](s32 w) {
+      Schedule& sched = (w == 0) ? m_sched : *scheds[w - 1];
+      Scorer& scorer = (w == 0) ? m_scorer : *scorers[w - 1];
+      if (w > 0 && hasAccepted)
+        ::applyMove(sched, scorer, accepted);
+      for (s32 i = w; i < batchSize; i += nWorkers) {
+        Proposal& p = batch[i];
+        Score curScore = scorer.score();
+        p.legal = p.legal && ::applyMove(sched, scorer, p.move);
+        if (p.legal) {
+          p.delta = scorer.score() - curScore;
+          ::undoMove(sched, scorer, p.move);
+        }
+      }
+    });
+
+    hasAccepted = false;
+    s32 i = 0;
+    for (; i < batchSize; ++i) {
+      const Proposal& p = batch[i];
+      if (p.legal && (p.delta >= 0 || p.prob < exp(p.delta / m_temperature)))
+        break;
+    }
+    m_iter += min(i + 1, batchSize);
+    if (i == batchSize)
+      continue;
+    try {
+      accepted = batch[i].move;
+      hasAccepted = true;
+      applyMove(accepted);
+      ++m_nAccepted;
+      if (m_scorer.score() > m_bestScore) {
+        if (!handleNewBest())
+          return false;
+        m_bestScore = m_scorer.score();
+      }
+    } catch(std::exception& e) {
+      cout << "Error in iter " << m_iter << ": " << e.what();
+      return false;
+    }
+  }
+  return outputStatus(info());
+}
+
+bool SpeculativeAnnealing::outputStatus(ostream& s) {
+  s << "Iter " << double(m_iter) << "/" << double(m_params.maxIterations)
+    << " (" << setprecision(4)
+    << left << (100.0 * m_iter / m_params.maxIterations) << right << "%) temperature: "
+    << m_temperature << " accepted: " << m_nAccepted << " score: " << m_scorer.score()
+    << " (dbg:" << m_scorer.calcScore() << ") best so far:" << m_bestScore;
+  outputGap(s) << endl;
+  reportProgress();
+  return saveBest();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "optimizer.hh"
+#include "parallel.hh"
+
+
+// Simulated annealing evaluating a batch of proposals at once. The proposals
+// and their acceptance probabilities are drawn by the main thread, workers
+// evaluate them against identical replicas of the schedule, and the first
+// accepted proposal in batch order is applied. Proposals after it are
+// discarded, so for a given seed and batch size the result doesn't depend on
+// the number of threads.
+class SpeculativeAnnealing final : public Optimizer {
+public:
+  SpeculativeAnnealing(Schedule& sched, const Options& params, Scorer& scorer,
+                       ScorerFactory scorerFactory) :
+    Optimizer(sched, params, scorer), m_scorerFactory(scorerFactory),
+    m_temperature(params.initTemp), m_nAccepted(0) {}
+
+  virtual bool run() override;
+
+protected:
+  struct Proposal {
+    Move move;
+    double prob;  // Uniform random number deciding acceptance
+    bool legal;
+    Score delta;
+  };
+
+  ScorerFactory m_scorerFactory;
+  double m_temperature;
+  u64 m_nAccepted;
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Temperature: " << m_temperature << std::endl;
+    s << "Accepted moves: " << m_nAccepted << std::endl;
+  }
+
+  bool outputStatus(std::ostream& s);
+};
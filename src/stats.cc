@@ -0,0 +1,122 @@
+#include "stats.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+
+void CountHistogram::reset(const vector<s32>& values) {
+  m_nIDs.assign(values.empty() ? 1 : *max_element(begin(values), end(values)) + 1, 0);
+  for (s32 v : values)
+    ++m_nIDs[v];
+}
+
+ScheduleStats::ScheduleStats(const Options& params) : m_params(params) {
+  CountHistogram hist;
+  hist.reset(params.instance->nRatedPerPerson);
+  m_nPeoplePerNRated = hist.nIDs();
+  hist.reset(params.instance->nRatingsPerAbstract);
+  m_nAbstractsPerNRatings = hist.nIDs();
+  m_nRatings = 0;
+  m_unmatchablePeople = 0;
+  for (s32 n : params.instance->nRatedPerPerson) {
+    m_nRatings += n;
+    m_unmatchablePeople += max(0, s32(params.minParticipations) - n);
+  }
+  m_unmatchableAbstracts = 0;
+  for (s32 n : params.instance->nRatingsPerAbstract)
+    m_unmatchableAbstracts += max(0, params.roomSize - 1 - n);
+  reset();
+}
+
+void ScheduleStats::reset() {
+  m_ratedHeardPerPerson.assign(m_params.nPeople, 0);
+  m_ratedHeardPerAbstract.assign(m_params.nAbstracts, 0);
+  m_nRatedHeard = 0;
+  m_personCountHist.reset(m_ratedHeardPerPerson);
+  m_abstractCountHist.reset(m_ratedHeardPerAbstract);
+  m_personRatedHeardHist.reset(m_ratedHeardPerPerson);
+  m_abstractRatedHeardHist.reset(m_ratedHeardPerAbstract);
+  vector<s32> buckets(m_params.nPeople);
+  for (ID personID = 0; personID < m_params.nPeople; ++personID)
+    buckets[personID] = percentBucket(0, m_params.instance->nRatedPerPerson[personID]);
+  m_personPercentHist.reset(buckets);
+  for (ID personID = 0; personID < m_params.nPeople; ++personID)
+    buckets[personID] = personPercentOfMaxBucket(personID, 0);
+  m_personPercentOfMaxHist.reset(buckets);
+  buckets.resize(m_params.nAbstracts);
+  for (ID abstractID = 0; abstractID < m_params.nAbstracts; ++abstractID)
+    buckets[abstractID] = percentBucket(0, m_params.instance->nRatingsPerAbstract[abstractID]);
+  m_abstractPercentHist.reset(buckets);
+}
+
+void ScheduleStats::changeRatedHeard(ID personID, ID abstractID, s32 delta) {
+  s32& personCount = m_ratedHeardPerPerson[personID];
+  s32 nRated = m_params.instance->nRatedPerPerson[personID];
+  m_personRatedHeardHist.change(personCount, personCount + delta);
+  m_personPercentHist.change(percentBucket(personCount, nRated),
+                             percentBucket(personCount + delta, nRated));
+  m_personPercentOfMaxHist.change(personPercentOfMaxBucket(personID, personCount),
+                                  personPercentOfMaxBucket(personID, personCount + delta));
+  personCount += delta;
+
+  s32& abstractCount = m_ratedHeardPerAbstract[abstractID];
+  s32 nRatings = m_params.instance->nRatingsPerAbstract[abstractID];
+  m_abstractRatedHeardHist.change(abstractCount, abstractCount + delta);
+  m_abstractPercentHist.change(percentBucket(abstractCount, nRatings),
+                               percentBucket(abstractCount + delta, nRatings));
+  abstractCount += delta;
+  m_nRatedHeard += delta;
+}
+
+static ostream& outputCounts(ostream& s, const vector<s32>& v, s32 skip=-1,
+                             const string& countSuffix="") {
+  for (s32 i = 0; i < static_cast<s32>(v.size()); ++i) {
+    if (v[i] > 0 && i != skip)
+      s << " " << i << countSuffix << ":" << v[i];
+  }
+  return s;
+}
+
+// Percent histogram, starting with the IDs without ratings
+static ostream& outputPercents(ostream& s, const vector<s32>& v, s32 noRatingsBucket) {
+  s << " N/A:" << (noRatingsBucket < static_cast<s32>(v.size()) ? v[noRatingsBucket] : 0);
+  return outputCounts(s, v, noRatingsBucket, "%");
+}
+
+void ScheduleStats::output(ostream& s) const {
+  s32 totalParticipations = m_params.nTimeslots * m_params.nRooms * (m_params.roomSize-1);
+
+  s << "nPeople:" << m_params.nPeople;
+  s << " nAbstracts:" << m_params.nAbstracts;
+  s << " nRooms:" << m_params.nRooms;
+  s << " nTimeslots:" << m_params.nTimeslots;
+  s << " Room size:" << m_params.roomSize << endl;
+  s << "nAbstracts ratings:" << m_nRatings << endl;
+  s << "nAbstracts rated and got:" << m_nRatedHeard << endl;
+  s << "Total participations (excl. presenters): " << totalParticipations << endl;
+  s << "Total forced unrated participations (people with less than " << m_params.minParticipations
+    << " rankings): " << m_unmatchablePeople << " (max matches: "
+    << (totalParticipations - m_unmatchablePeople) << ")" << endl;
+  s << "Total forced unrated participations (abstracts with less than " << (m_params.roomSize - 1)
+    << " rankings): " << m_unmatchableAbstracts << " (max matches: "
+    << (totalParticipations - m_unmatchableAbstracts) << ")" << endl;
+  s << "nPeople per number of participations:";
+  outputCounts(s, m_personCountHist.nIDs()) << endl;
+  s << "nPeople per abstracts rated:";
+  outputCounts(s, m_nPeoplePerNRated) << endl;
+  s << "nPeople per abstracts rated got:";
+  outputCounts(s, m_personRatedHeardHist.nIDs()) << endl;
+  s << "nAbstracts per number of presentations:";
+  outputCounts(s, m_abstractCountHist.nIDs()) << endl;
+  s << "nAbstracts per times rated:";
+  outputCounts(s, m_nAbstractsPerNRatings) << endl;
+  s << "nAbstracts per times rated and got:";
+  outputCounts(s, m_abstractRatedHeardHist.nIDs()) << endl;
+  s << "nAbstracts per ratings got percent:";
+  outputPercents(s, m_abstractPercentHist.nIDs(), NO_RATINGS_BUCKET) << endl;
+  s << "nPeople per ratings got percent:";
+  outputPercents(s, m_personPercentHist.nIDs(), NO_RATINGS_BUCKET) << endl;
+  s << "nPeople per ratings got of their max percent:";
+  outputPercents(s, m_personPercentOfMaxHist.nIDs(), NO_RATINGS_BUCKET) << endl;
+}
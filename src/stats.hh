@@ -0,0 +1,72 @@
+#pragma once
+
+#include "defs.hh"
+#include "params.hh"
+
+#include <ostream>
+#include <vector>
+
+
+// Number of IDs per value of a per ID count, updated as the counts change
+class CountHistogram final {
+public:
+  void reset(const std::vector<s32>& values);
+  void change(s32 from, s32 to) {
+    --m_nIDs[from];
+    if (to >= static_cast<s32>(m_nIDs.size()))
+      m_nIDs.resize(to + 1, 0);
+    ++m_nIDs[to];
+  }
+  const std::vector<s32>& nIDs() const { return m_nIDs; }
+
+protected:
+  std::vector<s32> m_nIDs;
+};
+
+// Statistics of a schedule, kept up to date by the schedule as seats change,
+// so a report costs only the size of the histograms
+class ScheduleStats final {
+public:
+  explicit ScheduleStats(const Options& params);
+
+  void reset();
+  void changePersonCount(s32 from, s32 to) { m_personCountHist.change(from, to); }
+  void changeAbstractCount(s32 from, s32 to) { m_abstractCountHist.change(from, to); }
+  // The person starts (delta 1) or stops (delta -1) hearing the abstract
+  void changeHeard(ID personID, ID abstractID, s32 delta) {
+    if (getRankingOrig(personID, abstractID, m_params) > 0)
+      changeRatedHeard(personID, abstractID, delta);
+  }
+
+  s32 nRatedHeard() const { return m_nRatedHeard; }
+  // People who rated abstracts but hear none of them
+  s32 nPeopleWithoutRatedHeard() const {
+    return m_personRatedHeardHist.nIDs()[0] - m_nPeoplePerNRated[0];
+  }
+
+  void output(std::ostream& s) const;
+
+protected:
+  // Percent histograms use bucket 101 for IDs without ratings
+  static const s32 NO_RATINGS_BUCKET = 101;
+
+  const Options& m_params;
+  // Rated heard (person, abstract) pairs per ID
+  std::vector<s32> m_ratedHeardPerPerson, m_ratedHeardPerAbstract;
+  s32 m_nRatedHeard;
+  CountHistogram m_personCountHist, m_abstractCountHist;
+  CountHistogram m_personRatedHeardHist, m_abstractRatedHeardHist;
+  CountHistogram m_personPercentHist, m_personPercentOfMaxHist, m_abstractPercentHist;
+  // Fixed by the ratings
+  std::vector<s32> m_nPeoplePerNRated, m_nAbstractsPerNRatings;
+  s32 m_nRatings, m_unmatchablePeople, m_unmatchableAbstracts;
+
+  void changeRatedHeard(ID personID, ID abstractID, s32 delta);
+  static s32 percentBucket(s32 count, s32 outOf) {
+    return (outOf == 0) ? NO_RATINGS_BUCKET : ((20 * count) / outOf) * 5;
+  }
+  s32 personPercentOfMaxBucket(ID personID, s32 count) const {
+    return percentBucket(count, std::min(m_params.instance->nRatedPerPerson[personID],
+                                         s32(m_params.maxParticipations)));
+  }
+};
@@ -0,0 +1,130 @@
+#include "sweep.hh"
+#include "elite.hh"
+#include "feasibility.hh"
+#include "pipeline.hh"
+#include "schedule.hh"
+#include "scorer.hh"
+#include "utils.hh"
+#include "workers.hh"
+
+#include <atomic>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+
+bool scenarioParams(const Params& params, const Scenario& scenario, size_t index, Params& res,
+                    string& failure) {
+  res = params;
+  res.scenarios.clear();
+  res.nTimeslots = scenario.nTimeslots;
+  res.nRooms = scenario.nRooms;
+  res.roomSize = scenario.roomSize;
+  res.participationRange = scenario.participationRange;
+  res.maxPresentations = scenario.maxPresentations;
+  shared_ptr<Instance> inst = editInstance(res);
+  inst->rankings = inst->rankingsOrigScores;
+  res.resultsDir = (boost::filesystem::path(params.resultsDir) /
+                    ("scenario_" + to_string(index + 1))).string();
+  if (!normalizeRankings(res, *inst)) {
+    failure = "bad ratings";
+    return false;
+  }
+  if (!compileConstraints(res, *inst)) {
+    failure = "bad constraints";
+    return false;
+  }
+  calcParticipationBounds(res);
+  return true;
+}
+
+static ScenarioResult runScenario(const Params& params, size_t index) {
+  ScenarioResult res{false, "failed", 0, 0, 0, 0, 0};
+  time_point startTime = chrono::system_clock::now();
+  FeasibilityReport feasibility = analyzeFeasibility(params);
+  if (!feasibility.feasible()) {
+    res.failure = "infeasible: " + feasibility.binding().name;
+    info() << "Scenario " << (index + 1) << " is " << res.failure << endl;
+    res.seconds = elapsedSecs(startTime);
+    return res;
+  }
+  // Each scenario has its own stream, whichever thread runs it
+  randSetSeed(params.seed, index);
+  try {
+    boost::filesystem::create_directories(params.resultsDir);
+    Schedule sched(params);
+    sched.initState();
+    if (runRestarts(sched, params)) {
+      res.score = SumHappinessScorer(sched, params).score();
+      res.minHappiness = MinHappinessBonusScorer(sched, params).calcMinPersonScore();
+      s32 seats = params.nTimeslots * params.nRooms * (params.roomSize - 1);
+      res.unratedSeats = seats - sched.stats().nRatedHeard();
+      res.unmatchedPeople = sched.stats().nPeopleWithoutRatedHeard();
+      res.ok = true;
+    }
+  } catch (const std::exception& e) {
+    err() << "Scenario " << (index + 1) << ": " << e.what() << endl;
+  }
+  res.seconds = elapsedSecs(startTime);
+  return res;
+}
+
+bool runSweep(const Params& params) {
+  const vector<Scenario>& scenarios = params.scenarios;
+  vector<Params> scenariosParams(scenarios.size());
+  vector<ScenarioResult> results(scenarios.size());
+  vector<bool> prepared(scenarios.size());
+  for (size_t i = 0; i < scenarios.size(); ++i) {
+    results[i] = ScenarioResult{false, "failed", 0, 0, 0, 0, 0};
+    prepared[i] = scenarioParams(params, scenarios[i], i, scenariosParams[i], results[i].failure);
+    if (!prepared[i])
+      info() << "Scenario " << (i + 1) << " has " << results[i].failure << endl;
+  }
+
+  s32 nThreads = params.sweepThreads;
+  if (nThreads <= 0)
+    nThreads = max(1u, thread::hardware_concurrency());
+  nThreads = min(nThreads, static_cast<s32>(scenarios.size()));
+  info() << "Sweeping " << scenarios.size() << " scenarios on " << nThreads << " threads" << endl;
+
+  atomic<size_t> nextScenario(0);
+  WorkerPool pool(nThreads);
+  pool.run([&](s32 worker) {
+    for (size_t i = nextScenario++; i < scenarios.size(); i = nextScenario++) {
+      if (!prepared[i])
+        continue;
+      auto& log = info() << "Scenario " << (i + 1) << ": ";
+      outputScenario(scenarios[i], log);
+      log << endl;
+      results[i] = runScenario(scenariosParams[i], i);
+    }
+  });
+
+  outputSweepTable(scenarios, scenariosParams, results, info() << "Sweep results:" << endl);
+  string tablePath = (boost::filesystem::path(params.resultsDir) / "sweep.csv").string();
+  ofstream tableFile(tablePath);
+  outputSweepTable(scenarios, scenariosParams, results, tableFile);
+  return checkWritten(tableFile, tablePath);
+}
+
+void outputSweepTable(const vector<Scenario>& scenarios, const vector<Params>& scenariosParams,
+                      const vector<ScenarioResult>& results, ostream& s) {
+  s << "scenario,timeslots,rooms,room_size,participation_range,max_presentations,"
+    << "min_participations,max_participations,score,min_happiness,unrated_seats,"
+    << "unmatched_people,seconds" << endl;
+  for (size_t i = 0; i < scenarios.size(); ++i) {
+    const Scenario& scenario = scenarios[i];
+    const ScenarioResult& res = results[i];
+    s << (i + 1) << "," << scenario.nTimeslots << "," << scenario.nRooms << ","
+      << scenario.roomSize << "," << scenario.participationRange << ","
+      << scenario.maxPresentations << "," << scenariosParams[i].minParticipations << ","
+      << scenariosParams[i].maxParticipations << ",";
+    if (res.ok)
+      s << res.score << "," << res.minHappiness << "," << res.unratedSeats << ","
+        << res.unmatchedPeople;
+    else
+      s << res.failure << ",,,";
+    s << "," << res.seconds << endl;
+  }
+}
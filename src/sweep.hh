@@ -0,0 +1,33 @@
+#pragma once
+
+#include "params.hh"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Outcome of the optimization pipeline on one scenario
+struct ScenarioResult {
+  bool ok;
+  std::string failure;  // Why the scenario didn't run, if not ok
+  Score score;          // Sum of ratings
+  Score minHappiness;   // Least satisfied person's fraction of their best
+  s32 unratedSeats;     // Listener seats at abstracts the listener didn't rate
+  s32 unmatchedPeople;  // People who hear none of the abstracts they rated
+  double seconds;
+};
+
+// Params of a scenario. Only redoes the normalization of the already
+// translated ratings, the input isn't read again. False, with the reason in
+// failure, if the ratings or the constraints don't fit the scenario.
+bool scenarioParams(const Params& params, const Scenario& scenario, size_t index, Params& res,
+                    std::string& failure);
+
+// Runs the phases on every scenario of params.scenarios, sweepThreads at a
+// time, and writes a comparison table to the results directory
+bool runSweep(const Params& params);
+
+void outputSweepTable(const std::vector<Scenario>& scenarios,
+                      const std::vector<Params>& scenariosParams,
+                      const std::vector<ScenarioResult>& results, std::ostream& s);
@@ -0,0 +1,114 @@
+#include "tabu.hh"
+
+#include <iomanip>
+
+using namespace std;
+
+
+TabuSearch::TabuSearch(Schedule& sched, const Options& params, Scorer& scorer) :
+  Optimizer(sched, params, scorer), m_step(0),
+  m_personTabuUntil(params.nTimeslots * params.nPeople, 0),
+  m_abstractTabuUntil(params.nTimeslots * params.nAbstracts, 0) {}
+
+bool TabuSearch::run() {
+  m_startTime = chrono::system_clock::now();
+  m_bestScore = m_scorer.score();
+  handleNewBest();
+  double nextOutputSec = 0;
+  for (m_iter = 0, m_step = 0; m_iter < m_params.maxIterations;) {
+    try {
+      oneStep();
+      if (m_scorer.score() > m_bestScore) {
+        if (!handleNewBest())
+          return false;
+        m_bestScore = m_scorer.score();
+      }
+    } catch(std::exception& e) {
+      err() << "Error in iter " << m_iter << ": " << e.what() << endl;
+      return false;
+    }
+    if (m_step % 100 == 0) {
+      if (elapsedSecs(m_startTime) >= nextOutputSec) {
+        if (!outputStatus(dbg()))
+          return false;
+        nextOutputSec += m_params.progressSeconds;
+      }
+      if (reachedStopCondition()) {
+        restoreBest();
+        break;
+      }
+    }
+  }
+  return outputStatus(info());
+}
+
+bool TabuSearch::oneStep() {
+  // Evaluate a sample of moves, each one is applied and undone
+  Move bestMove;
+  Score bestMoveScore = 0;
+  bool found = false;
+  for (s32 i = 0; i < m_params.tabuCandidates && m_iter < m_params.maxIterations; ++i, ++m_iter) {
+    Move move;
+    if (!proposeMove(move) || !applyMove(move))
+      continue;
+    Score newScore = m_scorer.score();
+    undoMove(move);
+    bool aspiration = newScore > m_bestScore;
+    if (!aspiration && isTabu(move))
+      continue;
+    if (!found || newScore > bestMoveScore) {
+      bestMove = move;
+      bestMoveScore = newScore;
+      found = true;
+    }
+  }
+  if (!found)
+    return false;
+  // Nothing changed since the evaluation, so the move is still legal
+  applyMove(bestMove);
+  setTabu(bestMove);
+  ++m_step;
+  return true;
+}
+
+// Calls f(id, isPresenter) for every ID that changes seat in the move. The
+// free ID of a change takes the first seat.
+template <typename F>
+void forEachMovedID(const Move& move, F f) {
+  if (validID(move.id1))
+    f(move.id1, move.seat1 == 0);
+  if (validID(move.id2))
+    f(move.id2, move.isSwap() ? move.seat2 == 0 : move.seat1 == 0);
+}
+
+bool TabuSearch::isTabu(const Move& move) {
+  bool tabu = false;
+  forEachMovedID(move, [&](ID id, bool isPresenter) {
+    if (isPresenter)
+      tabu |= m_abstractTabuUntil[move.timeslot * m_params.nAbstracts + id] > m_step;
+    else
+      tabu |= m_personTabuUntil[move.timeslot * m_params.nPeople + id] > m_step;
+  });
+  return tabu;
+}
+
+void TabuSearch::setTabu(const Move& move) {
+  u64 until = m_step + m_params.tabuTenure;
+  forEachMovedID(move, [&](ID id, bool isPresenter) {
+    if (isPresenter)
+      m_abstractTabuUntil[move.timeslot * m_params.nAbstracts + id] = until;
+    else
+      m_personTabuUntil[move.timeslot * m_params.nPeople + id] = until;
+  });
+}
+
+bool TabuSearch::outputStatus(ostream& s) {
+  s << "Iter " << double(m_iter) << "/" << double(m_params.maxIterations)
+    << " (" << setprecision(4)
+    << left << (100.0 * m_iter / m_params.maxIterations) << right << "%) step: "
+    << m_step << " score: " << m_scorer.score() << " (dbg:" << m_scorer.calcScore()
+    << ") best so far:" << m_bestScore;
+  outputGap(s) << endl;
+  reportProgress();
+  return saveBest();
+}
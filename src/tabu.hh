@@ -0,0 +1,28 @@
+#pragma once
+
+#include "optimizer.hh"
+
+
+// Tabu search: each step samples a candidate list of moves, applies the best
+// one which isn't tabu (or beats the best score so far) and forbids moving
+// the same people in that timeslot, or changing that presenter, for a while.
+class TabuSearch final : public Optimizer {
+public:
+  TabuSearch(Schedule& sched, const Options& params, Scorer& scorer);
+
+  virtual bool run() override;
+
+protected:
+  u64 m_step;
+  std::vector<u64> m_personTabuUntil;   // (timeslot, personID) -> step
+  std::vector<u64> m_abstractTabuUntil; // (timeslot, abstractID) -> step
+
+  virtual void outputMetadata(std::ostream& s) override {
+    s << "Step: " << m_step << std::endl;
+  }
+
+  bool oneStep();
+  bool isTabu(const Move& move);
+  void setTabu(const Move& move);
+  bool outputStatus(std::ostream& s);
+};
@@ -3,9 +3,8 @@
 #include <boost/iostreams/device/null.hpp>
 #include <chrono>
 #include <iomanip>
-#include <random>
-
 #include "defs.hh"
+#include "random.hh"
 
 using namespace std;
 
@@ -33,8 +32,22 @@ std::ostream& warn() { return logstream(cerr, "WARNING"); }
 std::ostream& info() { return logstream(cerr, "INFO"); }
 std::ostream& dbg()  { return verboseMode ? logstream(cerr, "DBG") : nullOstream; }
 
-// Random generator utilities
-mt19937 randEngine;
-void randSetSeed(int seed) { randEngine.seed(seed); }
-s32 randInt(s32 exclusiveMax) { return uniform_int_distribution<s32>(0, exclusiveMax - 1)(randEngine); }
-double randProb() { return uniform_real_distribution<double>(0, 1)(randEngine); }
+bool checkWritten(const ostream& file, const string& path) {
+  if (file.bad() || file.fail()) {
+    err() << "Error writing '" << path << "'" << endl;
+    return false;
+  }
+  return true;
+}
+
+// Random generator utilities (one generator per thread)
+thread_local RandBlock randSource;
+void randSetSeed(u64 seed, u32 stream) {
+  Rng rng(seed);
+  for (u32 i = 0; i < stream; ++i)
+    rng.jump();
+  randSource.reset(rng);
+}
+u64 randNext() { return randSource.next(); }
+s32 randInt(s32 exclusiveMax) { return boundedRand(randSource, exclusiveMax); }
+double randProb() { return bitsToProb(randSource.next()); }
@@ -13,10 +13,17 @@ std::ostream& warn();
 std::ostream& info();
 std::ostream& dbg();
 
-void randSetSeed(int seed);
+// Random numbers from the calling thread's generator. Stream n of a seed is
+// the seeded generator jumped n times, so threads seeded with the same seed
+// and different streams don't overlap.
+void randSetSeed(u64 seed, u32 stream=0);
+u64 randNext();
 s32 randInt(s32 exclusiveMax);
 double randProb();
 
+// False, after logging an error, if writing the file at path failed
+bool checkWritten(const std::ostream& file, const std::string& path);
+
 // Time utilities
 using time_point = std::chrono::time_point<std::chrono::system_clock>;
 double elapsedSecs(time_point start);
@@ -0,0 +1,55 @@
+#include "workers.hh"
+
+using namespace std;
+
+
+WorkerPool::WorkerPool(s32 nWorkers) :
+  m_task(nullptr), m_generation(0), m_pending(0), m_stop(false) {
+  for (s32 w = 1; w < nWorkers; ++w)
+    m_threads.emplace_back(&WorkerPool::workerLoop, this, w);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_startCond.notify_all();
+  for (thread& th : m_threads)
+    th.join();
+}
+
+void WorkerPool::run(const function<void(s32)>& task) {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_task = &task;
+    m_pending = m_threads.size();
+    ++m_generation;
+  }
+  m_startCond.notify_all();
+  task(0);
+  unique_lock<mutex> lock(m_mutex);
+  m_doneCond.wait(lock, [this]() { return m_pending == 0; });
+  m_task = nullptr;
+}
+
+void WorkerPool::workerLoop(s32 worker) {
+  u64 seenGeneration = 0;
+  while (true) {
+    const function<void(s32)>* task;
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_startCond.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+      if (m_stop)
+        return;
+      seenGeneration = m_generation;
+      task = m_task;
+    }
+    (*task)(worker);
+    {
+      lock_guard<mutex> lock(m_mutex);
+      --m_pending;
+    }
+    m_doneCond.notify_one();
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "defs.hh"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of threads running the same task together. The calling thread
+// takes part as worker 0, so a pool of size 1 starts no threads.
+class WorkerPool final {
+public:
+  explicit WorkerPool(s32 nWorkers);
+  ~WorkerPool();
+
+  s32 size() const { return m_threads.size() + 1; }
+
+  // Runs task(worker) on every worker and returns when all are done
+  void run(const std::function<void(s32)>& task);
+
+protected:
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_startCond, m_doneCond;
+  const std::function<void(s32)>* m_task;
+  u64 m_generation;
+  s32 m_pending;
+  bool m_stop;
+
+  void workerLoop(s32 worker);
+};